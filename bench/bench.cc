@@ -0,0 +1,486 @@
+#include "expr_gen.h"
+
+#include "batch_eval.h"
+#include "bytecode.h"
+#include "closure.h"
+#include "eval.h"
+#include "flat_ast.h"
+#include "lexer.h"
+#include "parallel_eval.h"
+#include "parser.h"
+#include "serialize.h"
+#include "static_expr.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pp_expr;
+
+/// every allocation of the process is counted, so a benchmark can report
+/// the bytes and calls its loop body costs
+static std::atomic<size_t> g_alloc_bytes{0};
+static std::atomic<size_t> g_alloc_calls{0};
+
+void* operator new(size_t size)
+{
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    g_alloc_calls.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace
+{
+struct BenchOptions {
+    GenOptions gen;
+    size_t exprs{2000};
+    size_t eval_exprs{32};
+    size_t rows{1 << 16};
+    double min_time{0.2};
+};
+
+struct AllocCount {
+    size_t bytes;
+    size_t calls;
+
+    static AllocCount now() {
+        return AllocCount{ g_alloc_bytes.load(), g_alloc_calls.load() };
+    }
+};
+
+using Clock = std::chrono::steady_clock;
+
+/// run `body` repeatedly for at least `min_time` seconds, return seconds per
+/// run and the allocations of one run
+template <typename F>
+double time_runs(double min_time, F&& body, AllocCount* per_run = nullptr)
+{
+    /// warm up: caches, lazily grown buffers
+    body();
+    size_t runs = 0;
+    auto alloc_begin = AllocCount::now();
+    auto begin = Clock::now();
+    double elapsed = 0;
+    do {
+        body();
+        runs++;
+        elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    } while (elapsed < min_time);
+    if (per_run) {
+        auto alloc_end = AllocCount::now();
+        per_run->bytes = (alloc_end.bytes - alloc_begin.bytes) / runs;
+        per_run->calls = (alloc_end.calls - alloc_begin.calls) / runs;
+    }
+    return elapsed / runs;
+}
+
+void report(const char* name, const char* metric, double value)
+{
+    std::printf("%-24s %-16s %14.2f\n", name, metric, value);
+}
+
+void report_rate(const char* name, const char* unit, double count, double seconds)
+{
+    std::string metric = std::string(unit) + "/s";
+    report(name, metric.c_str(), count / seconds);
+}
+
+bool parse_option(const char* arg, BenchOptions& options)
+{
+    const char* eq = std::strchr(arg, '=');
+    if (!eq) {
+        return false;
+    }
+    std::string key(arg, eq - arg);
+    double value = std::atof(eq + 1);
+    if (key == "exprs") options.exprs = static_cast<size_t>(value);
+    else if (key == "eval_exprs") options.eval_exprs = static_cast<size_t>(value);
+    else if (key == "rows") options.rows = static_cast<size_t>(value);
+    else if (key == "min_time") options.min_time = value;
+    else if (key == "depth") options.gen.max_depth = static_cast<size_t>(value);
+    else if (key == "width") options.gen.width = static_cast<size_t>(value);
+    else if (key == "idents") options.gen.idents = static_cast<size_t>(value);
+    else if (key == "seed") options.gen.seed = static_cast<uint64_t>(value);
+    else if (key == "arith") options.gen.arith = static_cast<unsigned>(value);
+    else if (key == "compare") options.gen.compare = static_cast<unsigned>(value);
+    else if (key == "logical") options.gen.logical = static_cast<unsigned>(value);
+    else if (key == "ternary") options.gen.ternary = static_cast<unsigned>(value);
+    else if (key == "unary") options.gen.unary = static_cast<unsigned>(value);
+    else if (key == "paren") options.gen.paren = static_cast<unsigned>(value);
+    else return false;
+    return true;
+}
+
+struct Corpus {
+    std::vector<std::string> sources;
+    std::vector<std::vector<Token>> tokens;
+    size_t bytes{0};
+    size_t token_count{0};
+    size_t node_count{0};
+};
+
+Corpus make_corpus(const BenchOptions& options)
+{
+    Corpus corpus;
+    ExprGenerator gen(options.gen);
+    FlatAst flat;
+    for (size_t i = 0; i < options.exprs; i++) {
+        corpus.sources.push_back(gen.next());
+    }
+    /// tokens refer to sources, fill them once the strings stop moving
+    for (auto& source : corpus.sources) {
+        corpus.tokens.push_back(tokenize(source));
+        parse_flat(corpus.tokens.back(), flat);
+        corpus.bytes += source.size();
+        corpus.token_count += corpus.tokens.back().size();
+        corpus.node_count += flat.size();
+    }
+    return corpus;
+}
+
+void bench_lex(const BenchOptions& options, const Corpus& corpus)
+{
+    std::vector<Token> tokens;
+    double seconds = time_runs(options.min_time, [&] {
+        for (auto& source : corpus.sources) {
+            tokens.clear();
+            tokenize(source, tokens);
+        }
+    });
+    report_rate("lex", "tokens", corpus.token_count, seconds);
+    report_rate("lex", "MB", corpus.bytes / 1e6, seconds);
+}
+
+void report_parse(const char* name, const Corpus& corpus, double seconds, const AllocCount& alloc)
+{
+    report_rate(name, "exprs", corpus.sources.size(), seconds);
+    report_rate(name, "tokens", corpus.token_count, seconds);
+    report_rate(name, "nodes", corpus.node_count, seconds);
+    report(name, "bytes/expr", static_cast<double>(alloc.bytes) / corpus.sources.size());
+    report(name, "allocs/expr", static_cast<double>(alloc.calls) / corpus.sources.size());
+}
+
+void bench_parse(const BenchOptions& options, const Corpus& corpus)
+{
+    AllocCount alloc{};
+    std::vector<Expr_t> asts(corpus.tokens.size());
+    double seconds = time_runs(options.min_time, [&] {
+        for (size_t i = 0; i < corpus.tokens.size(); i++) {
+            Parser parser(corpus.tokens[i]);
+            asts[i] = parser.parse();
+        }
+    }, &alloc);
+    report_parse("parse/heap", corpus, seconds, alloc);
+
+    std::vector<ArenaAst> arena_asts(corpus.tokens.size());
+    seconds = time_runs(options.min_time, [&] {
+        for (size_t i = 0; i < corpus.tokens.size(); i++) {
+            arena_asts[i] = parse_arena(corpus.tokens[i]);
+        }
+    }, &alloc);
+    report_parse("parse/arena", corpus, seconds, alloc);
+
+    FlatAst flat;
+    seconds = time_runs(options.min_time, [&] {
+        for (auto& tokens : corpus.tokens) {
+            parse_flat(tokens, flat);
+        }
+    }, &alloc);
+    report_parse("parse/flat", corpus, seconds, alloc);
+}
+
+void bench_print(const BenchOptions& options, const Corpus& corpus)
+{
+    std::vector<Expr_t> asts;
+    for (auto& tokens : corpus.tokens) {
+        Parser parser(tokens);
+        asts.push_back(parser.parse());
+    }
+    size_t bytes = 0;
+    double seconds = time_runs(options.min_time, [&] {
+        std::ostringstream ostr;
+        for (auto& ast : asts) {
+            ostr << *ast << '\n';
+        }
+        bytes = ostr.str().size();
+    });
+    report_rate("print/ostream", "exprs", asts.size(), seconds);
+    report_rate("print/ostream", "MB", bytes / 1e6, seconds);
+
+    TextBuffer out;
+    seconds = time_runs(options.min_time, [&] {
+        out.clear();
+        for (auto& ast : asts) {
+            write_sexpr(*ast, out);
+            out.append('\n');
+        }
+    });
+    report_rate("print/sexpr", "exprs", asts.size(), seconds);
+    report_rate("print/sexpr", "MB", out.size() / 1e6, seconds);
+
+    seconds = time_runs(options.min_time, [&] {
+        out.clear();
+        for (auto& ast : asts) {
+            write_json(*ast, out);
+            out.append('\n');
+        }
+    });
+    report_rate("print/json", "exprs", asts.size(), seconds);
+    report_rate("print/json", "MB", out.size() / 1e6, seconds);
+}
+
+void bench_eval(const BenchOptions& options, const Corpus& corpus)
+{
+    size_t count = std::min(options.eval_exprs, corpus.sources.size());
+    size_t rows = options.rows;
+    std::vector<Expr_t> asts;
+    for (size_t i = 0; i < count; i++) {
+        Parser parser(corpus.tokens[i]);
+        asts.push_back(parser.parse());
+    }
+
+    /// one input column per identifier
+    std::vector<std::string> names;
+    std::vector<std::vector<double>> data(options.gen.idents);
+    Columns columns;
+    std::mt19937_64 rng(options.gen.seed);
+    std::uniform_real_distribution<double> dist(-100, 100);
+    for (size_t c = 0; c < data.size(); c++) {
+        names.push_back("x" + std::to_string(c));
+        data[c].resize(rows);
+        for (auto& value : data[c]) {
+            value = dist(rng);
+        }
+        columns.bind(names[c], data[c].data());
+    }
+    std::vector<double> out(rows);
+    double total_rows = static_cast<double>(rows) * count;
+
+    /// the row-at-a-time engines get a smaller share of rows, per row cost
+    /// is what is measured
+    size_t scalar_rows = std::min<size_t>(rows, 4096);
+    double scalar_total = static_cast<double>(scalar_rows) * count;
+    Bindings bindings;
+    std::vector<double*> cells;
+    for (auto& name : names) {
+        bindings.set(name, 0.0);
+        cells.push_back(bindings.find(name)->data());
+    }
+    double sink = 0;
+    double seconds = time_runs(options.min_time, [&] {
+        for (auto& ast : asts) {
+            for (size_t r = 0; r < scalar_rows; r++) {
+                for (size_t c = 0; c < cells.size(); c++) {
+                    *cells[c] = data[c][r];
+                }
+                sink += evaluate(*ast, bindings);
+            }
+        }
+    });
+    report_rate("eval/tree", "rows", scalar_total, seconds);
+
+    SymbolTable symbols;
+    SymbolBuilder symbol_builder(symbols);
+    std::vector<Expr_t> symbol_asts;
+    for (size_t i = 0; i < count; i++) {
+        Parser parser(corpus.tokens[i], symbol_builder);
+        symbol_asts.push_back(parser.parse());
+    }
+    ResolvedBindings slots(symbols, bindings);
+    seconds = time_runs(options.min_time, [&] {
+        for (auto& ast : symbol_asts) {
+            for (size_t r = 0; r < scalar_rows; r++) {
+                for (size_t c = 0; c < cells.size(); c++) {
+                    *cells[c] = data[c][r];
+                }
+                sink += evaluate(*ast, slots);
+            }
+        }
+    });
+    report_rate("eval/tree/slots", "rows", scalar_total, seconds);
+
+    std::vector<Program> programs;
+    for (auto& ast : asts) {
+        programs.push_back(compile(*ast));
+    }
+    Vm vm;
+    seconds = time_runs(options.min_time, [&] {
+        for (auto& program : programs) {
+            vm.bind(program, bindings);
+            for (size_t r = 0; r < scalar_rows; r++) {
+                for (size_t c = 0; c < cells.size(); c++) {
+                    *cells[c] = data[c][r];
+                }
+                sink += vm.run(program);
+            }
+        }
+    });
+    report_rate("eval/vm", "rows", scalar_total, seconds);
+
+    std::vector<ClosureProgram> closures;
+    for (auto& ast : asts) {
+        closures.emplace_back(*ast, bindings);
+    }
+    seconds = time_runs(options.min_time, [&] {
+        for (auto& closure : closures) {
+            for (size_t r = 0; r < scalar_rows; r++) {
+                for (size_t c = 0; c < cells.size(); c++) {
+                    *cells[c] = data[c][r];
+                }
+                sink += closure.run();
+            }
+        }
+    });
+    report_rate("eval/closure", "rows", scalar_total, seconds);
+
+    /// setup cost, what short lived expressions pay before their first row
+    seconds = time_runs(options.min_time, [&] {
+        for (auto& ast : asts) {
+            sink += compile(*ast).code.size();
+        }
+    });
+    report_rate("build/vm", "exprs", count, seconds);
+    seconds = time_runs(options.min_time, [&] {
+        for (auto& ast : asts) {
+            sink += ClosureProgram(*ast, bindings).size();
+        }
+    });
+    report_rate("build/closure", "exprs", count, seconds);
+
+    std::vector<BatchProgram> batches;
+    for (auto& ast : asts) {
+        batches.emplace_back(*ast);
+    }
+    seconds = time_runs(options.min_time, [&] {
+        for (auto& batch : batches) {
+            batch.run(columns, 0, rows, out.data());
+        }
+    });
+    std::string name = std::string("eval/batch/") + BatchProgram::isa();
+    report_rate(name.c_str(), "rows", total_rows, seconds);
+
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        ThreadPool pool(threads);
+        seconds = time_runs(options.min_time, [&] {
+            for (auto& batch : batches) {
+                evaluate_parallel(batch, columns, rows, out.data(), pool);
+            }
+        });
+        name = "eval/parallel/" + std::to_string(threads);
+        report_rate(name.c_str(), "rows", total_rows, seconds);
+    }
+    /// keep the scalar loops from being optimized away
+    if (sink == 42.4242) {
+        std::printf("\n");
+    }
+}
+
+/// one formula fixed in source: interpreted tree, PP_EXPR_STATIC and plain C++
+void bench_fixed(const BenchOptions& options)
+{
+    constexpr auto formula = PP_EXPR_STATIC("a * b + (c - a) / 4 > b ? a - c * 2 : b + c * c");
+    size_t rows = options.rows;
+    std::vector<double> data[3];
+    std::mt19937_64 rng(options.gen.seed);
+    std::uniform_real_distribution<double> dist(-100, 100);
+    for (auto& column : data) {
+        column.resize(rows);
+        for (auto& value : column) {
+            value = dist(rng);
+        }
+    }
+
+    auto tokens = tokenize(formula.source());
+    Parser parser(tokens);
+    auto ast = parser.parse();
+    Bindings bindings;
+    double* cells[3];
+    for (size_t c = 0; c < 3; c++) {
+        bindings.set(std::string(formula.variable(c)), 0.0);
+        cells[c] = bindings.find(std::string(formula.variable(c)))->data();
+    }
+    double sink = 0;
+    double seconds = time_runs(options.min_time, [&] {
+        for (size_t r = 0; r < rows; r++) {
+            for (size_t c = 0; c < 3; c++) {
+                *cells[c] = data[c][r];
+            }
+            sink += evaluate(*ast, bindings);
+        }
+    });
+    report_rate("fixed/tree", "rows", rows, seconds);
+
+    seconds = time_runs(options.min_time, [&] {
+        for (size_t r = 0; r < rows; r++) {
+            sink += formula(data[0][r], data[1][r], data[2][r]);
+        }
+    });
+    report_rate("fixed/static", "rows", rows, seconds);
+
+    seconds = time_runs(options.min_time, [&] {
+        for (size_t r = 0; r < rows; r++) {
+            double a = data[0][r], b = data[1][r], c = data[2][r];
+            sink += a * b + (c - a) / 4 > b ? a - c * 2 : b + c * c;
+        }
+    });
+    report_rate("fixed/native", "rows", rows, seconds);
+    if (sink == 42.4242) {
+        std::printf("\n");
+    }
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (!parse_option(argv[i], options)) {
+            std::fprintf(stderr,
+                "usage: %s [exprs=N] [eval_exprs=N] [rows=N] [min_time=SEC] [seed=N]\n"
+                "          [depth=N] [width=N] [idents=N]\n"
+                "          [arith=W] [compare=W] [logical=W] [ternary=W] [unary=W] [paren=W]\n",
+                argv[0]);
+            return 1;
+        }
+    }
+
+    auto corpus = make_corpus(options);
+    std::printf("# %zu exprs, %zu tokens, %zu nodes, %zu bytes; depth=%zu width=%zu idents=%zu seed=%llu\n",
+        corpus.sources.size(), corpus.token_count, corpus.node_count, corpus.bytes,
+        options.gen.max_depth, options.gen.width, options.gen.idents,
+        static_cast<unsigned long long>(options.gen.seed));
+#ifndef NDEBUG
+    std::printf("# assertions enabled, configure with -DCMAKE_BUILD_TYPE=Release for representative numbers\n");
+#endif
+
+    bench_lex(options, corpus);
+    bench_parse(options, corpus);
+    bench_print(options, corpus);
+    bench_eval(options, corpus);
+    bench_fixed(options);
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "expr_gen.h"
+
+namespace pp_expr
+{
+static const char* const kArith[] = { "+", "-", "*", "/" };
+static const char* const kCompare[] = { "==", "!=", "<", "<=", ">", ">=" };
+static const char* const kLogical[] = { "&&", "||" };
+static const char* const kUnary[] = { "-", "+" };
+
+ExprGenerator::ExprGenerator(const GenOptions& options)
+    : options_(options), rng_(options.seed)
+{
+    if (options_.idents == 0) {
+        options_.idents = 1;
+    }
+}
+
+std::string ExprGenerator::next()
+{
+    std::string out;
+    for (size_t i = 0; i < options_.width; i++) {
+        if (i) {
+            out += ' ';
+            out += pick(kArith, 4);
+            out += ' ';
+        }
+        gen(out, 0);
+    }
+    return out;
+}
+
+const char* ExprGenerator::pick(const char* const* ops, size_t count)
+{
+    return ops[rng_() % count];
+}
+
+void ExprGenerator::gen_leaf(std::string& out)
+{
+    if (rng_() % 3 == 0) {
+        /// literals of a few shapes: 7, 2.5, .25
+        switch (rng_() % 3) {
+        case 0: out += std::to_string(rng_() % 100); break;
+        case 1: out += std::to_string(rng_() % 10) + "." + std::to_string(rng_() % 10); break;
+        default: out += "." + std::to_string(rng_() % 100 + 1); break;
+        }
+        return;
+    }
+    out += 'x';
+    out += std::to_string(rng_() % options_.idents);
+}
+
+void ExprGenerator::gen(std::string& out, size_t depth)
+{
+    /// deeper levels are more likely to stop at a leaf
+    if (depth >= options_.max_depth || rng_() % (options_.max_depth + 1) < depth) {
+        gen_leaf(out);
+        return;
+    }
+    const unsigned weights[] = {
+        options_.arith, options_.compare, options_.logical,
+        options_.ternary, options_.unary, options_.paren,
+    };
+    unsigned total = 0;
+    for (auto weight : weights) {
+        total += weight;
+    }
+    if (total == 0) {
+        gen_leaf(out);
+        return;
+    }
+    unsigned roll = rng_() % total;
+    size_t kind = 0;
+    while (roll >= weights[kind]) {
+        roll -= weights[kind++];
+    }
+
+    switch (kind) {
+    case 0:
+    case 1:
+    case 2: {
+        static const char* const* tables[] = { kArith, kCompare, kLogical };
+        static const size_t sizes[] = { 4, 6, 2 };
+        gen(out, depth + 1);
+        out += ' ';
+        out += pick(tables[kind], sizes[kind]);
+        out += ' ';
+        gen(out, depth + 1);
+        break;
+    }
+    case 3:
+        /// parenthesized, since ?: binds looser than any operator around it
+        out += '(';
+        gen(out, depth + 1);
+        out += " ? ";
+        gen(out, depth + 1);
+        out += " : ";
+        gen(out, depth + 1);
+        out += ')';
+        break;
+    case 4:
+        out += pick(kUnary, 2);
+        /// keep '-' '-' from lexing as '--'
+        out += ' ';
+        gen(out, depth + 1);
+        break;
+    default:
+        out += '(';
+        gen(out, depth + 1);
+        out += ')';
+        break;
+    }
+}
+}  // namespace pp_expr
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+namespace pp_expr
+{
+/// shape of generated expressions; operator weights are relative, 0 turns
+/// a class off. Only side effect free operators are produced, so every
+/// expression can be run by every evaluation engine.
+struct GenOptions {
+    size_t max_depth{6};  ///< operator nesting below the top level chain
+    size_t width{4};      ///< operands chained at the top level
+    size_t idents{8};     ///< distinct identifiers x0 .. x<idents-1>
+    uint64_t seed{1};
+
+    unsigned arith{6};    ///< + - * /
+    unsigned compare{2};  ///< == != < <= > >=
+    unsigned logical{1};  ///< && ||
+    unsigned ternary{1};  ///< ?:
+    unsigned unary{1};    ///< prefix - +
+    unsigned paren{1};    ///< ( )
+};
+
+/// deterministic stream of random expressions for a given seed
+class ExprGenerator {
+public:
+    explicit ExprGenerator(const GenOptions& options);
+
+    std::string next();
+private:
+    void gen(std::string& out, size_t depth);
+    void gen_leaf(std::string& out);
+    const char* pick(const char* const* ops, size_t count);
+
+    GenOptions options_;
+    std::mt19937_64 rng_;
+};
+}  // namespace pp_expr
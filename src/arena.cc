@@ -0,0 +1,34 @@
+#include "arena.h"
+#include "instrument.h"
+
+#include <algorithm>
+
+namespace pp_expr
+{
+/// blocks double in size up to this, so big parses need few blocks
+static const size_t kMaxBlockSize = 1 << 20;
+
+void* Arena::allocate_slow(size_t size, size_t align)
+{
+    size_t block_size = std::max(block_size_, size + align);
+    blocks_.emplace_back(new char[block_size]);
+    PP_EXPR_STAT(note_alloc(block_size));
+    bytes_reserved_ += block_size;
+    ptr_ = blocks_.back().get();
+    end_ = ptr_ + block_size;
+    block_size_ = std::min(block_size_ * 2, std::max(kMaxBlockSize, block_size_));
+    return allocate(size, align);
+}
+
+void Arena::reset()
+{
+    for (auto* cleanup = cleanups_; cleanup; cleanup = cleanup->next) {
+        cleanup->destroy(cleanup->object);
+    }
+    cleanups_ = nullptr;
+    blocks_.clear();
+    ptr_ = end_ = nullptr;
+    bytes_used_ = 0;
+    bytes_reserved_ = 0;
+}
+}  // namespace pp_expr
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pp_expr
+{
+/// bump allocator, objects are carved out of large blocks and all released
+/// together when the arena is destroyed or reset
+class Arena {
+public:
+    explicit Arena(size_t block_size = 4096) : block_size_(block_size) {}
+    ~Arena() { reset(); }
+
+    Arena(const Arena&) = delete;
+    Arena& operator =(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align)
+    {
+        auto p = reinterpret_cast<uintptr_t>(ptr_);
+        auto aligned = (p + align - 1) & ~(uintptr_t)(align - 1);
+        if (ptr_ == nullptr || aligned + size > reinterpret_cast<uintptr_t>(end_)) {
+            return allocate_slow(size, align);
+        }
+        ptr_ = reinterpret_cast<char*>(aligned + size);
+        bytes_used_ += size;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    /// construct T in arena, its destructor runs when the arena is released
+    /// unless T is trivially destructible
+    template <typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            auto* cleanup = new (allocate(sizeof(Cleanup), alignof(Cleanup))) Cleanup;
+            cleanup->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+            cleanup->object = object;
+            cleanup->next = cleanups_;
+            cleanups_ = cleanup;
+        }
+        return object;
+    }
+
+    /// run pending destructors and release all blocks
+    void reset();
+
+    size_t bytes_used() const { return bytes_used_; }
+    size_t bytes_reserved() const { return bytes_reserved_; }
+    size_t block_count() const { return blocks_.size(); }
+private:
+    void* allocate_slow(size_t size, size_t align);
+
+    struct Cleanup {
+        void (*destroy)(void*);
+        void* object;
+        Cleanup* next;
+    };
+
+    size_t block_size_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* ptr_{nullptr};
+    char* end_{nullptr};
+    Cleanup* cleanups_{nullptr};
+    size_t bytes_used_{0};
+    size_t bytes_reserved_{0};
+};
+}  // namespace pp_expr
@@ -0,0 +1,35 @@
+#include "ast.h"
+
+#include <vector>
+
+namespace pp_expr
+{
+void release_subtree(Expr_t& child)
+{
+    /// list of the outermost call on this thread; a plain pointer, so it
+    /// stays usable while static trees are destroyed at exit
+    thread_local std::vector<Expr_t>* graveyard = nullptr;
+
+    /// shared children only lose a reference, that never recurses;
+    /// non-owning (arena) pointers have no count and are left alone
+    if (child.use_count() != 1) {
+        child.reset();
+        return;
+    }
+    if (graveyard) {
+        graveyard->push_back(std::move(child));
+        return;
+    }
+    std::vector<Expr_t> nodes;
+    graveyard = &nodes;
+    /// destroying a node queues its own children here
+    Expr_t node = std::move(child);
+    node.reset();
+    while (!nodes.empty()) {
+        node = std::move(nodes.back());
+        nodes.pop_back();
+        node.reset();
+    }
+    graveyard = nullptr;
+}
+}  // namespace pp_expr
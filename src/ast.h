@@ -1,28 +1,61 @@
 #pragma once
 
+#include "instrument.h"
 #include "tokens.h"
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <ostream>
 
 namespace pp_expr
 {
+/// node types of the expression tree
+enum class ExprKind : uint8_t {
+    Number,
+    Ident,
+    Unary,
+    PostfixUnary,
+    Binary,
+    Tenary,
+};
+
 struct Expr {
+    explicit Expr(ExprKind kind) : kind_(kind) {}
     virtual ~Expr() = default;
 
+    /// node type tag, lets consumers switch on it instead of dynamic_cast
+    ExprKind kind() const { return kind_; }
+
     virtual std::ostream& visit(std::ostream& os) const = 0;
+
+    ExprKind kind_;
 };
 
 using Expr_t = std::shared_ptr<Expr>;
 
+/// operator tokens stored in tree use static lexeme text, so the tree never
+/// points into the source buffer it was parsed from
+inline Token canonical(const Token& op)
+{
+    return Token{ op.token_type, Lexeme(op.token_type) };
+}
+
+/// drops a child of a dying node; the last reference goes to a list owned
+/// by the outermost call on the thread, drained in a loop, so a deep tree
+/// is torn down without one call frame per level
+void release_subtree(Expr_t& child);
+
 inline std::ostream& operator <<(std::ostream& os, const Expr& ast)
 {
     return ast.visit(os);
 }
 
 struct Number : public Expr {
-    Number(double value) : value_(value) {}
+    Number(double value) : Expr(ExprKind::Number), value_(value) {}
+
+    static bool classof(ExprKind kind) { return kind == ExprKind::Number; }
 
     double value() const { return value_; }
 
@@ -33,53 +66,88 @@ struct Number : public Expr {
     double value_;
 };
 
+/// id of an identifier not interned in any SymbolTable
+static constexpr uint32_t kNoSymbol = UINT32_MAX;
+
+/// an identifier's id and the SymbolTable it belongs to
+struct SymbolId {
+    uint32_t table{0};      ///< SymbolTable::tag(), 0 for none
+    uint32_t id{kNoSymbol};
+
+    uint64_t bits() const { return (static_cast<uint64_t>(table) << 32) | id; }
+};
+
 struct Ident : public Expr {
-    Ident(const std::string& value) : value_(value) { }
+    Ident(std::string_view value, SymbolId symbol = {})
+        : Expr(ExprKind::Ident), value_(value), symbol_(symbol) { }
+
+    static bool classof(ExprKind kind) { return kind == ExprKind::Ident; }
 
     const std::string& value() const { return value_; }
+    /// set when parsed through a SymbolBuilder
+    const SymbolId& symbol() const { return symbol_; }
+    uint32_t id() const { return symbol_.id; }
     std::ostream& visit(std::ostream& os) const override {
         return os << value();
     }
 
     std::string value_;
+    SymbolId symbol_;
 };
 
 struct UnaryExpr : public Expr {
     UnaryExpr(const Token& op, const Expr_t& operand)
-        : op_(op), operand_(operand)
+        : UnaryExpr(ExprKind::Unary, op, operand)
     {}
+    ~UnaryExpr() override { release_subtree(operand_); }
+
+    /// postfix nodes are unary nodes too
+    static bool classof(ExprKind kind) {
+        return kind == ExprKind::Unary || kind == ExprKind::PostfixUnary;
+    }
+
     const Token& op() const { return op_; }
     const Expr_t& operand() const { return operand_; }
 
     std::ostream& visit(std::ostream& os) const override {
-        return os << "(" << op().lexeme << " " << *operand() << ")";
+        return os << "(" << op().lexeme() << " " << *operand() << ")";
     }
 
     Token op_;
     Expr_t operand_;
+protected:
+    UnaryExpr(ExprKind kind, const Token& op, const Expr_t& operand)
+        : Expr(kind), op_(canonical(op)), operand_(operand)
+    {}
 };
 
 /// postfix unary operation, for example: a++, b--
 struct PostfixUnaryExpr : public UnaryExpr {
     PostfixUnaryExpr(const Token& op, const Expr_t& operand)
-        : UnaryExpr(op, operand)
+        : UnaryExpr(ExprKind::PostfixUnary, op, operand)
     {}
 
+    static bool classof(ExprKind kind) { return kind == ExprKind::PostfixUnary; }
+
     std::ostream& visit(std::ostream& os) const override {
-        return os << "(" << *operand() << " " << op().lexeme << ")";
+        return os << "(" << *operand() << " " << op().lexeme() << ")";
     }
 };
 
 struct BinaryExpr : public Expr {
     BinaryExpr(const Token& op, const Expr_t& left, const Expr_t& right)
-        : op_(op), left_(left), right_(right)
+        : Expr(ExprKind::Binary), op_(canonical(op)), left_(left), right_(right)
     {}
+    ~BinaryExpr() override { release_subtree(left_); release_subtree(right_); }
+
+    static bool classof(ExprKind kind) { return kind == ExprKind::Binary; }
+
     const Token& op() const { return op_; }
     const Expr_t& left() const { return left_; }
     const Expr_t& right() const { return right_; }
 
     std::ostream& visit(std::ostream& os) const override {
-        return os << "(" << op().lexeme
+        return os << "(" << op().lexeme()
                   << " " << *left()
                   << " " << *right()
                   << ")";
@@ -92,15 +160,23 @@ struct BinaryExpr : public Expr {
 
 struct TenaryExpr : public Expr {
     TenaryExpr(const Token& op, const Expr_t& operand1, const Expr_t& operand2, const Expr_t& operand3)
-        : op_(op), operand1_(operand1), operand2_(operand2), operand3_(operand3)
+        : Expr(ExprKind::Tenary), op_(canonical(op)), operand1_(operand1), operand2_(operand2), operand3_(operand3)
     {}
+    ~TenaryExpr() override {
+        release_subtree(operand1_);
+        release_subtree(operand2_);
+        release_subtree(operand3_);
+    }
+
+    static bool classof(ExprKind kind) { return kind == ExprKind::Tenary; }
+
     const Token& op() const { return op_; }
     const Expr_t& operand1() const { return operand1_; }
     const Expr_t& operand2() const { return operand2_; }
     const Expr_t& operand3() const { return operand3_; }
 
     std::ostream& visit(std::ostream& os) const override {
-        return os << "(" << op().lexeme
+        return os << "(" << op().lexeme()
                   << " " << *operand1()
                   << " " << *operand2()
                   << " " << *operand3()
@@ -116,7 +192,11 @@ struct TenaryExpr : public Expr {
 template <typename T, typename... Args>
 inline Expr_t MakeExpr(Args&&... args)
 {
+#if PP_EXPR_INSTRUMENT
+    return std::allocate_shared<T>(CountingAllocator<T>(), std::forward<Args>(args)...);
+#else
     return std::make_shared<T>(std::forward<Args>(args)...);
+#endif
 }
 
 }  // namespace pp_expr
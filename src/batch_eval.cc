@@ -0,0 +1,284 @@
+#include "batch_eval.h"
+#include "visitor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PP_EXPR_SIMD_WIDTH 4
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PP_EXPR_SIMD_WIDTH 2
+#else
+#define PP_EXPR_SIMD_WIDTH 0
+#endif
+
+namespace pp_expr
+{
+namespace
+{
+/// thin wrappers so kernels are written once for every instruction set;
+/// comparisons return all-ones/all-zeros lane masks
+#if defined(__AVX2__)
+using vec = __m256d;
+inline vec load(const double* p) { return _mm256_loadu_pd(p); }
+inline void store(double* p, vec v) { _mm256_storeu_pd(p, v); }
+inline vec set1(double x) { return _mm256_set1_pd(x); }
+inline vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+inline vec sub(vec a, vec b) { return _mm256_sub_pd(a, b); }
+inline vec mul(vec a, vec b) { return _mm256_mul_pd(a, b); }
+inline vec div(vec a, vec b) { return _mm256_div_pd(a, b); }
+inline vec cmp_eq(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+inline vec cmp_ne(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_NEQ_UQ); }
+inline vec cmp_lt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+inline vec cmp_le(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+inline vec cmp_gt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+inline vec cmp_ge(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+inline vec and_(vec a, vec b) { return _mm256_and_pd(a, b); }
+inline vec or_(vec a, vec b) { return _mm256_or_pd(a, b); }
+inline vec xor_(vec a, vec b) { return _mm256_xor_pd(a, b); }
+inline vec blend(vec mask, vec t, vec f) { return _mm256_blendv_pd(f, t, mask); }
+#elif defined(__SSE2__)
+using vec = __m128d;
+inline vec load(const double* p) { return _mm_loadu_pd(p); }
+inline void store(double* p, vec v) { _mm_storeu_pd(p, v); }
+inline vec set1(double x) { return _mm_set1_pd(x); }
+inline vec add(vec a, vec b) { return _mm_add_pd(a, b); }
+inline vec sub(vec a, vec b) { return _mm_sub_pd(a, b); }
+inline vec mul(vec a, vec b) { return _mm_mul_pd(a, b); }
+inline vec div(vec a, vec b) { return _mm_div_pd(a, b); }
+inline vec cmp_eq(vec a, vec b) { return _mm_cmpeq_pd(a, b); }
+inline vec cmp_ne(vec a, vec b) { return _mm_cmpneq_pd(a, b); }
+inline vec cmp_lt(vec a, vec b) { return _mm_cmplt_pd(a, b); }
+inline vec cmp_le(vec a, vec b) { return _mm_cmple_pd(a, b); }
+inline vec cmp_gt(vec a, vec b) { return _mm_cmpgt_pd(a, b); }
+inline vec cmp_ge(vec a, vec b) { return _mm_cmpge_pd(a, b); }
+inline vec and_(vec a, vec b) { return _mm_and_pd(a, b); }
+inline vec or_(vec a, vec b) { return _mm_or_pd(a, b); }
+inline vec xor_(vec a, vec b) { return _mm_xor_pd(a, b); }
+/// no blendv before SSE4.1
+inline vec blend(vec mask, vec t, vec f) { return _mm_or_pd(_mm_and_pd(mask, t), _mm_andnot_pd(mask, f)); }
+#endif
+
+/// out[i] = op(a[i], b[i], c[i]), vector body and scalar tail
+template <typename VecOp, typename ScalarOp>
+inline void kernel(double* out, const double* a, const double* b, const double* c, size_t n,
+    VecOp vop, ScalarOp sop)
+{
+    size_t i = 0;
+#if PP_EXPR_SIMD_WIDTH
+    for (; i + PP_EXPR_SIMD_WIDTH <= n; i += PP_EXPR_SIMD_WIDTH) {
+        store(out + i, vop(load(a + i), b ? load(b + i) : set1(0), c ? load(c + i) : set1(0)));
+    }
+#else
+    (void)vop;
+#endif
+    for (; i < n; i++) {
+        out[i] = sop(a[i], b ? b[i] : 0, c ? c[i] : 0);
+    }
+}
+
+#if PP_EXPR_SIMD_WIDTH
+#define VEC_OP(expr) [](vec a, vec b, vec c) { (void)b; (void)c; return expr; }
+#define VEC_CMP(cmp) VEC_OP(and_(cmp(a, b), set1(1)))
+#else
+#define VEC_OP(expr) nullptr
+#define VEC_CMP(cmp) nullptr
+#endif
+#define SCALAR_OP(expr) [](double a, double b, double c) -> double { (void)b; (void)c; return expr; }
+
+void run_step(BatchProgram::StepOp op, double* out,
+    const double* a, const double* b, const double* c, size_t n)
+{
+    switch (op) {
+    case BatchProgram::STEP_NEG:
+        return kernel(out, a, b, c, n, VEC_OP(xor_(a, set1(-0.0))), SCALAR_OP(-a));
+    case BatchProgram::STEP_ADD:
+        return kernel(out, a, b, c, n, VEC_OP(add(a, b)), SCALAR_OP(a + b));
+    case BatchProgram::STEP_SUB:
+        return kernel(out, a, b, c, n, VEC_OP(sub(a, b)), SCALAR_OP(a - b));
+    case BatchProgram::STEP_MUL:
+        return kernel(out, a, b, c, n, VEC_OP(mul(a, b)), SCALAR_OP(a * b));
+    case BatchProgram::STEP_DIV:
+        return kernel(out, a, b, c, n, VEC_OP(div(a, b)), SCALAR_OP(a / b));
+    case BatchProgram::STEP_EQ:
+        return kernel(out, a, b, c, n, VEC_CMP(cmp_eq), SCALAR_OP(a == b));
+    case BatchProgram::STEP_NE:
+        return kernel(out, a, b, c, n, VEC_CMP(cmp_ne), SCALAR_OP(a != b));
+    case BatchProgram::STEP_LT:
+        return kernel(out, a, b, c, n, VEC_CMP(cmp_lt), SCALAR_OP(a < b));
+    case BatchProgram::STEP_LE:
+        return kernel(out, a, b, c, n, VEC_CMP(cmp_le), SCALAR_OP(a <= b));
+    case BatchProgram::STEP_GT:
+        return kernel(out, a, b, c, n, VEC_CMP(cmp_gt), SCALAR_OP(a > b));
+    case BatchProgram::STEP_GE:
+        return kernel(out, a, b, c, n, VEC_CMP(cmp_ge), SCALAR_OP(a >= b));
+    case BatchProgram::STEP_AND:
+        return kernel(out, a, b, c, n,
+            VEC_OP(and_(and_(cmp_ne(a, set1(0)), cmp_ne(b, set1(0))), set1(1))),
+            SCALAR_OP(a != 0 && b != 0));
+    case BatchProgram::STEP_OR:
+        return kernel(out, a, b, c, n,
+            VEC_OP(and_(or_(cmp_ne(a, set1(0)), cmp_ne(b, set1(0))), set1(1))),
+            SCALAR_OP(a != 0 || b != 0));
+    case BatchProgram::STEP_SELECT:
+        return kernel(out, a, b, c, n,
+            VEC_OP(blend(cmp_ne(a, set1(0)), b, c)),
+            SCALAR_OP(a != 0 ? b : c));
+    }
+}
+}  // namespace
+
+const char* BatchProgram::isa()
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+BatchProgram::BatchProgram(const Expr& expr)
+{
+    result_ = lower(expr);
+}
+
+BatchProgram::Operand BatchProgram::emit(StepOp op, std::initializer_list<Operand> args, uint32_t temp_base)
+{
+    /// operands are consumed by this step, so it can reuse their temporaries
+    next_temp_ = temp_base;
+    Step step{ op, next_temp_++, {} };
+    temp_count_ = std::max(temp_count_, next_temp_);
+    std::copy(args.begin(), args.end(), step.args);
+    steps_.push_back(step);
+    return Operand{ Operand::Temp, step.dst };
+}
+
+BatchProgram::Operand BatchProgram::lower(const Expr& expr)
+{
+    uint32_t temp_base = next_temp_;
+    switch (expr.kind()) {
+    case ExprKind::Number: {
+        double value = expr_cast<Number>(expr).value();
+        auto it = std::find_if(consts_.begin(), consts_.end(),
+            [value](double c) { return std::memcmp(&c, &value, sizeof(value)) == 0; });
+        if (it == consts_.end()) {
+            it = consts_.insert(consts_.end(), value);
+        }
+        return Operand{ Operand::Const, static_cast<uint32_t>(it - consts_.begin()) };
+    }
+    case ExprKind::Ident: {
+        auto& name = expr_cast<Ident>(expr).value();
+        auto it = std::find(columns_.begin(), columns_.end(), name);
+        if (it == columns_.end()) {
+            it = columns_.insert(columns_.end(), name);
+        }
+        return Operand{ Operand::Column, static_cast<uint32_t>(it - columns_.begin()) };
+    }
+    case ExprKind::Unary: {
+        auto& unary = expr_cast<UnaryExpr>(expr);
+        if (unary.op().token_type == TOK_PLUS) {
+            return lower(*unary.operand());
+        }
+        if (unary.op().token_type == TOK_MINUS) {
+            auto a = lower(*unary.operand());
+            return emit(STEP_NEG, { a }, temp_base);
+        }
+        throw EvalError(std::string("batch evaluation doesn't support prefix ")
+            + Lexeme(unary.op().token_type));
+    }
+    case ExprKind::PostfixUnary:
+        throw EvalError("batch evaluation doesn't support postfix operators");
+    case ExprKind::Binary: {
+        auto& binary = expr_cast<BinaryExpr>(expr);
+        StepOp op;
+        switch (binary.op().token_type) {
+        case TOK_PLUS:  op = STEP_ADD; break;
+        case TOK_MINUS: op = STEP_SUB; break;
+        case TOK_STAR:  op = STEP_MUL; break;
+        case TOK_SLASH: op = STEP_DIV; break;
+        case TOK_EQ:    op = STEP_EQ; break;
+        case TOK_NE:    op = STEP_NE; break;
+        case TOK_LT:    op = STEP_LT; break;
+        case TOK_LE:    op = STEP_LE; break;
+        case TOK_GT:    op = STEP_GT; break;
+        case TOK_GE:    op = STEP_GE; break;
+        case TOK_AND:   op = STEP_AND; break;
+        case TOK_OR:    op = STEP_OR; break;
+        default:
+            throw EvalError(std::string("batch evaluation doesn't support ")
+                + Lexeme(binary.op().token_type));
+        }
+        auto a = lower(*binary.left());
+        auto b = lower(*binary.right());
+        return emit(op, { a, b }, temp_base);
+    }
+    case ExprKind::Tenary: {
+        auto& tenary = expr_cast<TenaryExpr>(expr);
+        auto c = lower(*tenary.operand1());
+        auto t = lower(*tenary.operand2());
+        auto f = lower(*tenary.operand3());
+        return emit(STEP_SELECT, { c, t, f }, temp_base);
+    }
+    }
+    throw EvalError("unknown expression kind");
+}
+
+void BatchProgram::run(const double* const* inputs, size_t begin, size_t end, double* out) const
+{
+    std::vector<double> scratch((consts_.size() + temp_count_) * kChunkRows);
+    double* const_chunks = scratch.data();
+    double* temp_chunks = const_chunks + consts_.size() * kChunkRows;
+    for (size_t i = 0; i < consts_.size(); i++) {
+        std::fill_n(const_chunks + i * kChunkRows, kChunkRows, consts_[i]);
+    }
+
+    for (size_t row = begin; row < end; row += kChunkRows) {
+        size_t n = std::min(kChunkRows, end - row);
+        auto chunk = [&](const Operand& operand) -> const double* {
+            switch (operand.kind) {
+            case Operand::Column: return inputs[operand.index] + row;
+            case Operand::Const: return const_chunks + operand.index * kChunkRows;
+            case Operand::Temp: return temp_chunks + operand.index * kChunkRows;
+            }
+            return nullptr;
+        };
+        for (size_t s = 0; s < steps_.size(); s++) {
+            auto& step = steps_[s];
+            /// root is the last step, it writes straight to output
+            double* dst = s + 1 == steps_.size() ? out + row : temp_chunks + step.dst * kChunkRows;
+            size_t arity = step.op == STEP_NEG ? 1 : step.op == STEP_SELECT ? 3 : 2;
+            run_step(step.op, dst,
+                chunk(step.args[0]),
+                arity > 1 ? chunk(step.args[1]) : nullptr,
+                arity > 2 ? chunk(step.args[2]) : nullptr,
+                n);
+        }
+        if (steps_.empty()) {
+            std::copy_n(chunk(result_), n, out + row);
+        }
+    }
+}
+
+void BatchProgram::run(const Columns& columns, size_t begin, size_t end, double* out) const
+{
+    std::vector<const double*> inputs;
+    inputs.reserve(columns_.size());
+    for (auto& name : columns_) {
+        auto* data = columns.find(name);
+        if (!data) {
+            throw EvalError("unbound column '" + name + "'");
+        }
+        inputs.push_back(data);
+    }
+    run(inputs.data(), begin, end, out);
+}
+
+void evaluate_batch(const Expr& expr, const Columns& columns, size_t rows, double* out)
+{
+    BatchProgram(expr).run(columns, 0, rows, out);
+}
+}  // namespace pp_expr
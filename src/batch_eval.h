@@ -0,0 +1,82 @@
+#pragma once
+
+#include "ast.h"
+#include "eval.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pp_expr
+{
+/// input columns of batch evaluation, every identifier reads one column
+class Columns {
+public:
+    void bind(const std::string& name, const double* data) { columns_[name] = data; }
+
+    const double* find(const std::string& name) const {
+        auto it = columns_.find(name);
+        return it == columns_.end() ? nullptr : it->second;
+    }
+private:
+    std::unordered_map<std::string, const double*> columns_;
+};
+
+/// expression lowered for column-at-a-time evaluation: the tree is walked
+/// once at construction, then every step runs a SIMD kernel (AVX2 or SSE2
+/// when the build targets them, scalar otherwise) over a chunk of rows.
+/// ?: && || evaluate both operands and combine them with masks, so only
+/// side effect free expressions are accepted: `=` `++` `--` `[]` `*` `&`
+/// raise EvalError. Immutable after construction, safe to run concurrently.
+class BatchProgram {
+public:
+    /// rows evaluated per step, small enough that temporaries stay in L1
+    static constexpr size_t kChunkRows = 256;
+
+    explicit BatchProgram(const Expr& expr);
+
+    /// identifiers used by the expression, in input order of run()
+    const std::vector<std::string>& columns() const { return columns_; }
+
+    /// evaluate rows [begin, end) into out[begin, end);
+    /// `inputs[i]` is the column of columns()[i]
+    void run(const double* const* inputs, size_t begin, size_t end, double* out) const;
+    /// same, resolving columns by name
+    void run(const Columns& columns, size_t begin, size_t end, double* out) const;
+
+    /// name of the instruction set kernels were compiled for
+    static const char* isa();
+
+    enum StepOp : uint8_t {
+        STEP_NEG, STEP_ADD, STEP_SUB, STEP_MUL, STEP_DIV,
+        STEP_EQ, STEP_NE, STEP_LT, STEP_LE, STEP_GT, STEP_GE,
+        STEP_AND, STEP_OR, STEP_SELECT,
+    };
+
+    /// operand of a step, a column, a constant or a temporary chunk
+    struct Operand {
+        enum Kind : uint8_t { Column, Const, Temp } kind;
+        uint32_t index;
+    };
+
+    struct Step {
+        StepOp op;
+        uint32_t dst;       // temporary
+        Operand args[3];
+    };
+private:
+    Operand lower(const Expr& expr);
+    Operand emit(StepOp op, std::initializer_list<Operand> args, uint32_t temp_base);
+
+    std::vector<Step> steps_;
+    std::vector<double> consts_;
+    std::vector<std::string> columns_;
+    Operand result_{};
+    uint32_t temp_count_{0};
+    uint32_t next_temp_{0};
+};
+
+/// evaluate `expr` for `rows` rows of `columns` into `out`
+void evaluate_batch(const Expr& expr, const Columns& columns, size_t rows, double* out);
+}  // namespace pp_expr
@@ -0,0 +1,70 @@
+#include "batch_parse.h"
+#include "builder.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <algorithm>
+
+namespace pp_expr
+{
+/// tasks per worker, so stealing can even out expensive runs
+static const size_t kTasksPerWorker = 4;
+
+static bool is_blank(std::string_view text)
+{
+    return std::all_of(text.begin(), text.end(), [](char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+    });
+}
+
+size_t ParsedBatch::error_count() const
+{
+    return std::count_if(errors.begin(), errors.end(), [](const Diagnostic& error) {
+        return static_cast<bool>(error);
+    });
+}
+
+std::vector<std::string_view> split_expressions(std::string_view buffer)
+{
+    std::vector<std::string_view> pieces;
+    size_t start = 0;
+    for (size_t i = 0; i <= buffer.size(); i++) {
+        if (i == buffer.size() || buffer[i] == '\n' || buffer[i] == ';') {
+            auto piece = buffer.substr(start, i - start);
+            if (!is_blank(piece)) {
+                pieces.push_back(piece);
+            }
+            start = i + 1;
+        }
+    }
+    return pieces;
+}
+
+ParsedBatch parse_batch(std::string_view buffer, ThreadPool& pool)
+{
+    auto pieces = split_expressions(buffer);
+    ParsedBatch batch;
+    batch.asts.resize(pieces.size());
+    batch.errors.resize(pieces.size());
+
+    size_t tasks = std::min(pieces.size(), pool.size() * kTasksPerWorker);
+    for (size_t i = 0; i < tasks; i++) {
+        batch.arenas.push_back(std::make_unique<Arena>());
+    }
+    pool.parallel_for(tasks, [&](size_t task) {
+        size_t begin = pieces.size() * task / tasks;
+        size_t end = pieces.size() * (task + 1) / tasks;
+        ArenaBuilder builder(*batch.arenas[task]);
+        std::vector<Token> tokens;
+        for (size_t i = begin; i < end; i++) {
+            tokens.clear();
+            tokenize(pieces[i], tokens);
+            Parser parser(tokens, builder);
+            auto result = parser.try_parse();
+            batch.asts[i] = std::move(result.ast);
+            batch.errors[i] = result.error;
+        }
+    });
+    return batch;
+}
+}  // namespace pp_expr
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "arena.h"
+#include "ast.h"
+#include "diagnostic.h"
+#include "thread_pool.h"
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace pp_expr
+{
+/// all expressions of one buffer, asts[i] is the i-th expression in buffer
+/// order, or null if it does not parse, with the reason in errors[i]; nodes
+/// are non-owning pointers into `arenas`, one per parse task, and error
+/// tokens are views into the buffer
+struct ParsedBatch {
+    std::vector<std::unique_ptr<Arena>> arenas;
+    std::vector<Expr_t> asts;
+    std::vector<Diagnostic> errors;
+
+    size_t error_count() const;
+};
+
+/// split `buffer` into expressions at newlines and semicolons, blank pieces
+/// are dropped
+std::vector<std::string_view> split_expressions(std::string_view buffer);
+
+/// parse every expression of `buffer` on `pool`; expressions are dealt to
+/// tasks in contiguous runs, each task tokenizes into a reused vector and
+/// builds into its own arena, so workers share nothing while parsing
+ParsedBatch parse_batch(std::string_view buffer, ThreadPool& pool);
+}  // namespace pp_expr
@@ -0,0 +1,418 @@
+#include "binary_ast.h"
+#include "operators.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pp_expr
+{
+static const uint16_t kByteOrder = 0x0102;
+
+uint32_t BinaryAstWriter::add(const Expr& expr)
+{
+    roots_.push_back(add_node(expr));
+    return static_cast<uint32_t>(roots_.size() - 1);
+}
+
+uint32_t BinaryAstWriter::add_node(const Expr& root)
+{
+    /// post-order walk with an explicit stack, trees may be deeper than the
+    /// call stack; `pending` holds finished subtrees like FlatBuilder does
+    std::vector<std::pair<const Expr*, bool>> stack{ { &root, false } };
+    std::vector<uint32_t> pending;
+    Mark mark{ nodes_.size(), children_.size(), numbers_.size(), idents_.size(), strings_.size() };
+    while (!stack.empty()) {
+        auto [expr, expanded] = stack.back();
+        ExprKind kind = expr->kind();
+        if (!expanded && child_count(kind) > 0) {
+            stack.back().second = true;
+            /// pushed in reverse so they complete left to right
+            switch (kind) {
+            case ExprKind::Unary:
+            case ExprKind::PostfixUnary:
+                stack.push_back({ static_cast<const UnaryExpr*>(expr)->operand().get(), false });
+                break;
+            case ExprKind::Binary: {
+                auto binary = static_cast<const BinaryExpr*>(expr);
+                stack.push_back({ binary->right().get(), false });
+                stack.push_back({ binary->left().get(), false });
+                break;
+            }
+            case ExprKind::Tenary: {
+                auto tenary = static_cast<const TenaryExpr*>(expr);
+                stack.push_back({ tenary->operand3().get(), false });
+                stack.push_back({ tenary->operand2().get(), false });
+                stack.push_back({ tenary->operand1().get(), false });
+                break;
+            }
+            default:
+                break;
+            }
+            continue;
+        }
+        stack.pop_back();
+
+        BinaryAstNode node{ static_cast<uint8_t>(kind), 0, 0, 0 };
+        switch (kind) {
+        case ExprKind::Number:
+            node.op = TOK_NUM;
+            node.arg = number_index(static_cast<const Number*>(expr)->value());
+            break;
+        case ExprKind::Ident:
+            node.op = TOK_ID;
+            node.arg = ident_index(static_cast<const Ident*>(expr)->value());
+            break;
+        case ExprKind::Unary:
+        case ExprKind::PostfixUnary:
+            node.op = static_cast<uint8_t>(static_cast<const UnaryExpr*>(expr)->op().token_type);
+            break;
+        case ExprKind::Binary:
+            node.op = static_cast<uint8_t>(static_cast<const BinaryExpr*>(expr)->op().token_type);
+            break;
+        case ExprKind::Tenary:
+            node.op = static_cast<uint8_t>(static_cast<const TenaryExpr*>(expr)->op().token_type);
+            break;
+        }
+        if (node.op >= TOK_USER) {
+            rollback(mark);
+            throw std::invalid_argument(std::string("user defined operator can't be saved: ")
+                                        + Lexeme(static_cast<TokenType>(node.op)));
+        }
+        uint32_t count = child_count(kind);
+        if (count > 0) {
+            node.arg = static_cast<uint32_t>(children_.size());
+            children_.insert(children_.end(), pending.end() - count, pending.end());
+            pending.resize(pending.size() - count);
+        }
+        pending.push_back(static_cast<uint32_t>(nodes_.size()));
+        nodes_.push_back(node);
+    }
+    return pending.back();
+}
+
+void BinaryAstWriter::rollback(const Mark& mark)
+{
+    nodes_.resize(mark.nodes);
+    children_.resize(mark.children);
+    for (size_t i = mark.numbers; i < numbers_.size(); i++) {
+        uint64_t bits;
+        std::memcpy(&bits, &numbers_[i], sizeof(bits));
+        number_index_.erase(bits);
+    }
+    numbers_.resize(mark.numbers);
+    for (size_t i = mark.idents; i < idents_.size(); i++) {
+        ident_index_.erase(strings_.substr(idents_[i].offset, idents_[i].size));
+    }
+    idents_.resize(mark.idents);
+    strings_.resize(mark.strings);
+}
+
+uint32_t BinaryAstWriter::number_index(double value)
+{
+    /// keyed by bit pattern, so -0.0 and NaN payloads survive
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto [it, inserted] = number_index_.emplace(bits, static_cast<uint32_t>(numbers_.size()));
+    if (inserted) {
+        numbers_.push_back(value);
+    }
+    return it->second;
+}
+
+uint32_t BinaryAstWriter::ident_index(const std::string& name)
+{
+    auto [it, inserted] = ident_index_.emplace(name, static_cast<uint32_t>(idents_.size()));
+    if (inserted) {
+        idents_.push_back({ static_cast<uint32_t>(strings_.size()), static_cast<uint32_t>(name.size()) });
+        strings_ += name;
+    }
+    return it->second;
+}
+
+/// `op` is a built-in operator of nodes of `kind`
+static bool is_operator_of(ExprKind kind, uint8_t op)
+{
+    auto& ops = OperatorTable::builtin();
+    auto type = static_cast<TokenType>(op);
+    switch (kind) {
+    case ExprKind::Unary:
+        return ops.prefix_kind(type) == PREFIX_UNARY;
+    case ExprKind::PostfixUnary:
+        return ops.infix_kind(type) == INFIX_POSTFIX;
+    case ExprKind::Binary: {
+        auto infix = ops.infix_kind(type);
+        return infix == INFIX_BINARY_LEFT || infix == INFIX_BINARY_RIGHT || infix == INFIX_INDEX;
+    }
+    case ExprKind::Tenary:
+        return ops.infix_kind(type) == INFIX_QUESTION;
+    default:
+        return false;
+    }
+}
+
+static uint32_t align8(size_t offset)
+{
+    return static_cast<uint32_t>((offset + 7) & ~size_t(7));
+}
+
+template <typename T>
+static void put(std::string& out, uint32_t offset, const std::vector<T>& items)
+{
+    if (!items.empty()) {
+        std::memcpy(&out[offset], items.data(), items.size() * sizeof(T));
+    }
+}
+
+std::string BinaryAstWriter::finish() const
+{
+    BinaryAstHeader header{};
+    header.magic = kBinaryAstMagic;
+    header.version = kBinaryAstVersion;
+    header.byte_order = kByteOrder;
+    header.expr_count = static_cast<uint32_t>(roots_.size());
+    header.node_count = static_cast<uint32_t>(nodes_.size());
+    header.child_count = static_cast<uint32_t>(children_.size());
+    header.number_count = static_cast<uint32_t>(numbers_.size());
+    header.ident_count = static_cast<uint32_t>(idents_.size());
+    header.string_bytes = static_cast<uint32_t>(strings_.size());
+
+    /// every section starts 8 byte aligned so it can be read in place
+    header.roots_offset = align8(sizeof(header));
+    header.nodes_offset = align8(header.roots_offset + roots_.size() * sizeof(uint32_t));
+    header.children_offset = align8(header.nodes_offset + nodes_.size() * sizeof(BinaryAstNode));
+    header.numbers_offset = align8(header.children_offset + children_.size() * sizeof(uint32_t));
+    header.idents_offset = align8(header.numbers_offset + numbers_.size() * sizeof(double));
+    header.strings_offset = align8(header.idents_offset + idents_.size() * sizeof(BinaryAstString));
+    header.total_size = align8(header.strings_offset + strings_.size());
+
+    std::string out(header.total_size, '\0');
+    std::memcpy(&out[0], &header, sizeof(header));
+    put(out, header.roots_offset, roots_);
+    put(out, header.nodes_offset, nodes_);
+    put(out, header.children_offset, children_);
+    put(out, header.numbers_offset, numbers_);
+    put(out, header.idents_offset, idents_);
+    if (!strings_.empty()) {
+        std::memcpy(&out[header.strings_offset], strings_.data(), strings_.size());
+    }
+    return out;
+}
+
+static bool fail(std::string* error, const char* message)
+{
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+/// section [offset, offset + count * size) lies inside `total` and is aligned
+static bool section_ok(uint32_t offset, uint32_t count, size_t size, size_t total)
+{
+    return offset % 8 == 0 && offset <= total && count <= (total - offset) / size;
+}
+
+bool BinaryAstView::open(const void* data, size_t size, std::string* error)
+{
+    *this = BinaryAstView();
+    auto base = static_cast<const char*>(data);
+    if (reinterpret_cast<uintptr_t>(base) % 8 != 0) {
+        return fail(error, "buffer is not 8 byte aligned");
+    }
+    if (size < sizeof(BinaryAstHeader)) {
+        return fail(error, "truncated header");
+    }
+    auto header = reinterpret_cast<const BinaryAstHeader*>(base);
+    if (header->magic != kBinaryAstMagic) {
+        return fail(error, "bad magic");
+    }
+    if (header->byte_order != kByteOrder) {
+        return fail(error, "written with a different byte order");
+    }
+    if (header->version != kBinaryAstVersion) {
+        return fail(error, "unsupported version");
+    }
+    if (header->total_size > size) {
+        return fail(error, "truncated data");
+    }
+    size_t total = header->total_size;
+    if (!section_ok(header->roots_offset, header->expr_count, sizeof(uint32_t), total)
+        || !section_ok(header->nodes_offset, header->node_count, sizeof(BinaryAstNode), total)
+        || !section_ok(header->children_offset, header->child_count, sizeof(uint32_t), total)
+        || !section_ok(header->numbers_offset, header->number_count, sizeof(double), total)
+        || !section_ok(header->idents_offset, header->ident_count, sizeof(BinaryAstString), total)
+        || !section_ok(header->strings_offset, header->string_bytes, 1, total)) {
+        return fail(error, "section out of bounds");
+    }
+
+    auto roots = reinterpret_cast<const uint32_t*>(base + header->roots_offset);
+    auto nodes = reinterpret_cast<const BinaryAstNode*>(base + header->nodes_offset);
+    auto children = reinterpret_cast<const uint32_t*>(base + header->children_offset);
+    auto idents = reinterpret_cast<const BinaryAstString*>(base + header->idents_offset);
+
+    for (uint32_t i = 0; i < header->ident_count; i++) {
+        if (idents[i].offset > header->string_bytes
+            || idents[i].size > header->string_bytes - idents[i].offset) {
+            return fail(error, "identifier out of bounds");
+        }
+    }
+    /// expressions are consecutive runs of nodes, each ending at its root
+    uint32_t begin = 0;
+    for (uint32_t i = 0; i < header->expr_count; i++) {
+        if (roots[i] < begin || roots[i] >= header->node_count) {
+            return fail(error, "bad root");
+        }
+        begin = roots[i] + 1;
+    }
+    if (begin != header->node_count) {
+        return fail(error, "nodes outside any expression");
+    }
+    /// children must precede their parent inside the same expression, which
+    /// also rules out cycles, so a valid view can be walked without checks
+    uint32_t expr = 0;
+    begin = 0;
+    for (uint32_t n = 0; n < header->node_count; n++) {
+        const BinaryAstNode& node = nodes[n];
+        if (node.kind > static_cast<uint8_t>(ExprKind::Tenary)) {
+            return fail(error, "bad node kind");
+        }
+        auto kind = static_cast<ExprKind>(node.kind);
+        uint32_t count = child_count(kind);
+        if (kind == ExprKind::Number) {
+            if (node.op != TOK_NUM || node.arg >= header->number_count) {
+                return fail(error, "bad number node");
+            }
+        } else if (kind == ExprKind::Ident) {
+            if (node.op != TOK_ID || node.arg >= header->ident_count) {
+                return fail(error, "bad identifier node");
+            }
+        } else {
+            if (!is_operator_of(kind, node.op)) {
+                return fail(error, "bad operator");
+            }
+            if (node.arg > header->child_count || count > header->child_count - node.arg) {
+                return fail(error, "children out of bounds");
+            }
+            for (uint32_t c = 0; c < count; c++) {
+                uint32_t child = children[node.arg + c];
+                if (child < begin || child >= n) {
+                    return fail(error, "child does not precede its parent");
+                }
+            }
+        }
+        if (n == roots[expr]) {
+            expr++;
+            begin = n + 1;
+        }
+    }
+
+    header_ = header;
+    roots_ = roots;
+    nodes_ = nodes;
+    children_ = children;
+    numbers_ = reinterpret_cast<const double*>(base + header->numbers_offset);
+    idents_ = idents;
+    strings_ = base + header->strings_offset;
+    return true;
+}
+
+Expr_t decode_ast(const BinaryAstView& view, size_t expr, AstBuilder& builder)
+{
+    /// nodes are in post-order, so one pass in order builds every child
+    /// before its parent; children are copied, a file may share them
+    assert(expr < view.size());
+    uint32_t begin = view.begin(expr);
+    uint32_t root = view.root(expr);
+    std::vector<Expr_t> built(root - begin + 1);
+    auto child = [&](uint32_t node, uint32_t n) -> const Expr_t& {
+        return built[view.child(node, n) - begin];
+    };
+    for (uint32_t node = begin; node <= root; node++) {
+        Token op{ view.op(node), {} };
+        if (child_count(view.kind(node)) > 0) {
+            op = canonical(op);
+        }
+        Expr_t& out = built[node - begin];
+        switch (view.kind(node)) {
+        case ExprKind::Number:
+            out = builder.number(view.number(node));
+            break;
+        case ExprKind::Ident:
+            out = builder.ident(view.ident(node));
+            break;
+        case ExprKind::Unary:
+            out = builder.unary(op, child(node, 0));
+            break;
+        case ExprKind::PostfixUnary:
+            out = builder.postfix_unary(op, child(node, 0));
+            break;
+        case ExprKind::Binary:
+            out = builder.binary(op, child(node, 0), child(node, 1));
+            break;
+        case ExprKind::Tenary:
+            out = builder.tenary(op, child(node, 0), child(node, 1),
+                child(node, 2));
+            break;
+        }
+    }
+    return std::move(built.back());
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path, std::string* error)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (error) {
+            *error = path + ": " + std::strerror(errno);
+        }
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        if (error) {
+            *error = path + ": " + std::strerror(errno);
+        }
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            if (error) {
+                *error = path + ": " + std::strerror(errno);
+            }
+            ::close(fd);
+            return false;
+        }
+        data_ = data;
+        size_ = size;
+    }
+    /// the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_) {
+        ::munmap(data_, size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+}  // namespace pp_expr
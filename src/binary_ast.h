@@ -0,0 +1,149 @@
+#pragma once
+
+#include "ast.h"
+#include "builder.h"
+#include "flat_ast.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pp_expr
+{
+/// Binary form of a set of parsed expressions, readable in place (e.g. from
+/// mmap) with no allocation per node. Everything is addressed by offsets,
+/// in host byte order, laid out as:
+///
+///     BinaryAstHeader
+///     uint32_t roots[expr_count]           root node of each expression
+///     BinaryAstNode nodes[node_count]      post-order, children first
+///     uint32_t children[child_count]       child node indices
+///     double numbers[number_count]
+///     BinaryAstString idents[ident_count]  interned identifiers
+///     char strings[string_bytes]
+///
+/// Nodes of one expression are contiguous and end at its root.
+static const uint32_t kBinaryAstMagic = 0x41585050;  // "PPXA"
+static const uint16_t kBinaryAstVersion = 1;
+
+struct BinaryAstHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t byte_order;  ///< 0x0102 as written by the producing host
+    uint32_t expr_count;
+    uint32_t node_count;
+    uint32_t child_count;
+    uint32_t number_count;
+    uint32_t ident_count;
+    uint32_t string_bytes;
+    uint32_t roots_offset;
+    uint32_t nodes_offset;
+    uint32_t children_offset;
+    uint32_t numbers_offset;
+    uint32_t idents_offset;
+    uint32_t strings_offset;
+    uint32_t total_size;
+    uint32_t reserved;
+};
+
+struct BinaryAstNode {
+    uint8_t kind;   ///< ExprKind
+    uint8_t op;     ///< TokenType, TOK_NUM/TOK_ID for leaves
+    uint16_t reserved;
+    uint32_t arg;   ///< leaves: index into numbers/idents, others: first child in children
+};
+
+struct BinaryAstString {
+    uint32_t offset;
+    uint32_t size;
+};
+
+/// collects expressions and writes them out in the format above
+class BinaryAstWriter {
+public:
+    /// index of the expression in the file; throws std::invalid_argument,
+    /// adding nothing, if it uses user defined operators (see operators.h),
+    /// their token types only mean something in this process
+    uint32_t add(const Expr& expr);
+    size_t size() const { return roots_.size(); }
+
+    /// serialized bytes of everything added so far
+    std::string finish() const;
+private:
+    /// sizes of every section, to undo a rejected expression
+    struct Mark {
+        size_t nodes, children, numbers, idents, strings;
+    };
+
+    uint32_t add_node(const Expr& expr);
+    void rollback(const Mark& mark);
+    uint32_t number_index(double value);
+    uint32_t ident_index(const std::string& name);
+
+    std::vector<uint32_t> roots_;
+    std::vector<BinaryAstNode> nodes_;
+    std::vector<uint32_t> children_;
+    std::vector<double> numbers_;
+    std::unordered_map<uint64_t, uint32_t> number_index_;
+    std::vector<BinaryAstString> idents_;
+    std::unordered_map<std::string, uint32_t> ident_index_;
+    std::string strings_;
+};
+
+/// read-only view over serialized bytes, which must stay alive and be
+/// 8 byte aligned (mmap and malloc memory are)
+class BinaryAstView {
+public:
+    BinaryAstView() = default;
+
+    /// check the header and every node once, so accessors need no checks;
+    /// false with `error` set if the data is not a valid file
+    bool open(const void* data, size_t size, std::string* error = nullptr);
+
+    size_t size() const { return header_ ? header_->expr_count : 0; }
+    uint32_t root(size_t expr) const { return roots_[expr]; }
+    /// first node of expression `expr`
+    uint32_t begin(size_t expr) const { return expr ? roots_[expr - 1] + 1 : 0; }
+
+    ExprKind kind(uint32_t node) const { return static_cast<ExprKind>(nodes_[node].kind); }
+    TokenType op(uint32_t node) const { return static_cast<TokenType>(nodes_[node].op); }
+    uint32_t child(uint32_t node, uint32_t n) const { return children_[nodes_[node].arg + n]; }
+    double number(uint32_t node) const { return numbers_[nodes_[node].arg]; }
+    std::string_view ident(uint32_t node) const {
+        auto& s = idents_[nodes_[node].arg];
+        return std::string_view(strings_ + s.offset, s.size);
+    }
+private:
+    const BinaryAstHeader* header_{nullptr};
+    const uint32_t* roots_{nullptr};
+    const BinaryAstNode* nodes_{nullptr};
+    const uint32_t* children_{nullptr};
+    const double* numbers_{nullptr};
+    const BinaryAstString* idents_{nullptr};
+    const char* strings_{nullptr};
+};
+
+/// rebuild expression `expr` of `view` through `builder`, without recursion;
+/// a node that several parents refer to is built once and shared
+Expr_t decode_ast(const BinaryAstView& view, size_t expr, AstBuilder& builder = heap_builder());
+
+/// read-only memory map of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator =(const MappedFile&) = delete;
+
+    bool open(const std::string& path, std::string* error = nullptr);
+    void close();
+
+    const void* data() const { return data_; }
+    size_t size() const { return size_; }
+private:
+    void* data_{nullptr};
+    size_t size_{0};
+};
+}  // namespace pp_expr
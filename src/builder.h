@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ast.h"
+#include "arena.h"
+
+#include <string_view>
+
+namespace pp_expr
+{
+/// decides how the parser's nodes are stored; the parser creates nodes in
+/// post-order, children are always built before their parent
+struct AstBuilder {
+    virtual ~AstBuilder() = default;
+
+    virtual Expr_t number(double value) = 0;
+    /// `symbol` is set by a SymbolBuilder, builders may store or ignore it
+    virtual Expr_t ident(std::string_view name, SymbolId symbol = {}) = 0;
+    virtual Expr_t unary(const Token& op, const Expr_t& operand) = 0;
+    virtual Expr_t postfix_unary(const Token& op, const Expr_t& operand) = 0;
+    virtual Expr_t binary(const Token& op, const Expr_t& left, const Expr_t& right) = 0;
+    virtual Expr_t tenary(const Token& op, const Expr_t& operand1,
+        const Expr_t& operand2, const Expr_t& operand3) = 0;
+};
+
+/// every node is its own shared_ptr allocation, see MakeExpr
+struct HeapBuilder : public AstBuilder {
+    Expr_t number(double value) override {
+        return MakeExpr<Number>(value);
+    }
+    Expr_t ident(std::string_view name, SymbolId symbol = {}) override {
+        return MakeExpr<Ident>(name, symbol);
+    }
+    Expr_t unary(const Token& op, const Expr_t& operand) override {
+        return MakeExpr<UnaryExpr>(op, operand);
+    }
+    Expr_t postfix_unary(const Token& op, const Expr_t& operand) override {
+        return MakeExpr<PostfixUnaryExpr>(op, operand);
+    }
+    Expr_t binary(const Token& op, const Expr_t& left, const Expr_t& right) override {
+        return MakeExpr<BinaryExpr>(op, left, right);
+    }
+    Expr_t tenary(const Token& op, const Expr_t& operand1,
+        const Expr_t& operand2, const Expr_t& operand3) override {
+        return MakeExpr<TenaryExpr>(op, operand1, operand2, operand3);
+    }
+};
+
+/// stateless, shared by all parsers without a builder of their own
+inline HeapBuilder& heap_builder()
+{
+    static HeapBuilder builder;
+    return builder;
+}
+
+/// nodes are placed in an arena and handed out as non-owning Expr_t
+/// (no control block), so copying them touches no reference count;
+/// the tree is only valid while the arena lives
+class ArenaBuilder : public AstBuilder {
+public:
+    explicit ArenaBuilder(Arena& arena) : arena_(arena) {}
+
+    Expr_t number(double value) override {
+        return make<Number>(value);
+    }
+    Expr_t ident(std::string_view name, SymbolId symbol = {}) override {
+        /// name may own heap memory, let arena run its destructor
+        return Expr_t(Expr_t(), arena_.create<Ident>(name, symbol));
+    }
+    Expr_t unary(const Token& op, const Expr_t& operand) override {
+        return make<UnaryExpr>(op, operand);
+    }
+    Expr_t postfix_unary(const Token& op, const Expr_t& operand) override {
+        return make<PostfixUnaryExpr>(op, operand);
+    }
+    Expr_t binary(const Token& op, const Expr_t& left, const Expr_t& right) override {
+        return make<BinaryExpr>(op, left, right);
+    }
+    Expr_t tenary(const Token& op, const Expr_t& operand1,
+        const Expr_t& operand2, const Expr_t& operand3) override {
+        return make<TenaryExpr>(op, operand1, operand2, operand3);
+    }
+
+    Arena& arena() { return arena_; }
+private:
+    /// these nodes only hold static lexemes and non-owning children, there
+    /// is nothing to release, so they are abandoned with the arena blocks
+    template <typename T, typename... Args>
+    Expr_t make(Args&&... args) {
+        T* node = new (arena_.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        return Expr_t(Expr_t(), node);
+    }
+
+    Arena& arena_;
+};
+}  // namespace pp_expr
@@ -0,0 +1,452 @@
+#include "bytecode.h"
+#include "visitor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace pp_expr
+{
+const char* OpCodeName(OpCode op)
+{
+    switch (op) {
+    case OP_CONST: return "const";
+    case OP_LOAD: return "load";
+    case OP_STORE: return "store";
+    case OP_LOAD_INDEX: return "load_index";
+    case OP_STORE_INDEX: return "store_index";
+    case OP_PRE_INC: return "pre_inc";
+    case OP_PRE_DEC: return "pre_dec";
+    case OP_POST_INC: return "post_inc";
+    case OP_POST_DEC: return "post_dec";
+    case OP_PRE_INC_INDEX: return "pre_inc_index";
+    case OP_PRE_DEC_INDEX: return "pre_dec_index";
+    case OP_POST_INC_INDEX: return "post_inc_index";
+    case OP_POST_DEC_INDEX: return "post_dec_index";
+    case OP_NEG: return "neg";
+    case OP_BOOL: return "bool";
+    case OP_ADD: return "add";
+    case OP_SUB: return "sub";
+    case OP_MUL: return "mul";
+    case OP_DIV: return "div";
+    case OP_EQ: return "eq";
+    case OP_NE: return "ne";
+    case OP_LT: return "lt";
+    case OP_LE: return "le";
+    case OP_GT: return "gt";
+    case OP_GE: return "ge";
+    case OP_JUMP: return "jump";
+    case OP_JUMP_IF_FALSE: return "jump_if_false";
+    case OP_JUMP_IF_FALSE_OR_POP: return "jump_if_false_or_pop";
+    case OP_JUMP_IF_TRUE_OR_POP: return "jump_if_true_or_pop";
+    case OP_RETURN: return "return";
+    }
+    return "?";
+}
+
+int Program::slot_of(const std::string& name) const
+{
+    auto it = std::find(slots.begin(), slots.end(), name);
+    return it == slots.end() ? -1 : static_cast<int>(it - slots.begin());
+}
+
+std::ostream& operator <<(std::ostream& os, const Program& program)
+{
+    for (size_t pc = 0; pc < program.code.size(); pc++) {
+        auto& instr = program.code[pc];
+        os << pc << ": " << OpCodeName(instr.op);
+        switch (instr.op) {
+        case OP_CONST:
+            os << " " << program.consts[instr.arg];
+            break;
+        case OP_NEG: case OP_BOOL: case OP_ADD: case OP_SUB: case OP_MUL:
+        case OP_DIV: case OP_EQ: case OP_NE: case OP_LT: case OP_LE:
+        case OP_GT: case OP_GE: case OP_RETURN:
+            break;
+        case OP_JUMP: case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_FALSE_OR_POP: case OP_JUMP_IF_TRUE_OR_POP:
+            os << " " << instr.arg;
+            break;
+        default:
+            os << " " << program.slots[instr.arg];
+            break;
+        }
+        os << "\n";
+    }
+    return os;
+}
+
+namespace
+{
+class Compiler : public ExprVisitor<Compiler> {
+public:
+    explicit Compiler(Program& program) : program_(program) {}
+
+    void compile(const Expr& expr) { visit(expr); }
+    void finish();
+
+    void visit_number(const Number& expr);
+    void visit_ident(const Ident& expr);
+    void visit_unary(const UnaryExpr& expr);
+    void visit_postfix_unary(const PostfixUnaryExpr& expr);
+    void visit_binary(const BinaryExpr& expr);
+    void visit_tenary(const TenaryExpr& expr);
+private:
+    /// `x` or `x[i]`, with slot and whether an index was pushed
+    uint32_t compile_lvalue(const Expr& expr, bool& indexed);
+    uint32_t ident_slot(const Expr& expr);
+
+    size_t emit(OpCode op, uint32_t arg = 0);
+    void patch(size_t at) { program_.code[at].arg = static_cast<uint32_t>(program_.code.size()); }
+    void push(int n = 1) {
+        depth_ += n;
+        program_.max_stack = std::max(program_.max_stack, depth_);
+    }
+    void pop(int n = 1) { depth_ -= n; }
+
+    Program& program_;
+    std::unordered_map<std::string, uint32_t> slots_;
+    /// keyed by bit pattern, so 0 and -0 stay distinct
+    std::unordered_map<uint64_t, uint32_t> consts_;
+    size_t depth_{0};
+};
+
+size_t Compiler::emit(OpCode op, uint32_t arg)
+{
+    program_.code.push_back(Instr{ op, arg });
+    return program_.code.size() - 1;
+}
+
+uint32_t Compiler::ident_slot(const Expr& expr)
+{
+    auto& name = expr_cast<Ident>(expr).value();
+    auto it = slots_.find(name);
+    if (it != slots_.end()) {
+        return it->second;
+    }
+    auto slot = static_cast<uint32_t>(program_.slots.size());
+    program_.slots.push_back(name);
+    program_.slot_written.push_back(false);
+    slots_.emplace(name, slot);
+    return slot;
+}
+
+void Compiler::visit_number(const Number& expr)
+{
+    double value = expr.value();
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto it = consts_.find(bits);
+    if (it == consts_.end()) {
+        it = consts_.emplace(bits, static_cast<uint32_t>(program_.consts.size())).first;
+        program_.consts.push_back(value);
+    }
+    emit(OP_CONST, it->second);
+    push();
+}
+
+void Compiler::visit_ident(const Ident& expr)
+{
+    emit(OP_LOAD, ident_slot(expr));
+    push();
+}
+
+void Compiler::visit_postfix_unary(const PostfixUnaryExpr& expr)
+{
+    bool indexed = false;
+    uint32_t slot = compile_lvalue(*expr.operand(), indexed);
+    bool inc = expr.op().token_type == TOK_INC;
+    if (!inc && expr.op().token_type != TOK_DEC) {
+        throw EvalError(std::string("unsupported postfix operator ") + Lexeme(expr.op().token_type));
+    }
+    if (indexed) {
+        emit(inc ? OP_POST_INC_INDEX : OP_POST_DEC_INDEX, slot);
+        pop();
+    } else {
+        emit(inc ? OP_POST_INC : OP_POST_DEC, slot);
+    }
+    push();
+}
+
+uint32_t Compiler::compile_lvalue(const Expr& expr, bool& indexed)
+{
+    if (isa<Ident>(expr)) {
+        indexed = false;
+        uint32_t slot = ident_slot(expr);
+        program_.slot_written[slot] = true;
+        return slot;
+    }
+    if (auto* index = dyn_expr_cast<BinaryExpr>(&expr)) {
+        if (index->op().token_type == TOK_LSQUAR && isa<Ident>(*index->left())) {
+            indexed = true;
+            uint32_t slot = ident_slot(*index->left());
+            compile(*index->right());
+            return slot;
+        }
+    }
+    throw EvalError("expression is not assignable");
+}
+
+void Compiler::visit_unary(const UnaryExpr& expr)
+{
+    auto op = expr.op().token_type;
+    switch (op) {
+    case TOK_PLUS:
+        compile(*expr.operand());
+        break;
+    case TOK_MINUS:
+        compile(*expr.operand());
+        emit(OP_NEG);
+        break;
+    case TOK_INC:
+    case TOK_DEC: {
+        bool indexed = false;
+        uint32_t slot = compile_lvalue(*expr.operand(), indexed);
+        if (indexed) {
+            emit(op == TOK_INC ? OP_PRE_INC_INDEX : OP_PRE_DEC_INDEX, slot);
+            pop();
+        } else {
+            emit(op == TOK_INC ? OP_PRE_INC : OP_PRE_DEC, slot);
+        }
+        push();
+        break;
+    }
+    default:
+        throw EvalError(std::string("unsupported prefix operator ") + Lexeme(op));
+    }
+}
+
+void Compiler::visit_binary(const BinaryExpr& expr)
+{
+    auto op = expr.op().token_type;
+    switch (op) {
+    case TOK_AND:
+    case TOK_OR: {
+        /// left, bool, jump out keeping it when it decides; else right, bool
+        compile(*expr.left());
+        emit(OP_BOOL);
+        size_t jump = emit(op == TOK_AND ? OP_JUMP_IF_FALSE_OR_POP : OP_JUMP_IF_TRUE_OR_POP);
+        pop();
+        compile(*expr.right());
+        emit(OP_BOOL);
+        patch(jump);
+        return;
+    }
+    case TOK_ASSIGN: {
+        /// right operand first, same order as the evaluator
+        compile(*expr.right());
+        bool indexed = false;
+        uint32_t slot = compile_lvalue(*expr.left(), indexed);
+        if (indexed) {
+            emit(OP_STORE_INDEX, slot);
+            pop();
+        } else {
+            emit(OP_STORE, slot);
+        }
+        return;
+    }
+    case TOK_LSQUAR: {
+        if (!isa<Ident>(*expr.left())) {
+            throw EvalError("only variables can be indexed");
+        }
+        uint32_t slot = ident_slot(*expr.left());
+        compile(*expr.right());
+        emit(OP_LOAD_INDEX, slot);
+        return;
+    }
+    default:
+        break;
+    }
+
+    OpCode code;
+    switch (op) {
+    case TOK_PLUS:  code = OP_ADD; break;
+    case TOK_MINUS: code = OP_SUB; break;
+    case TOK_STAR:  code = OP_MUL; break;
+    case TOK_SLASH: code = OP_DIV; break;
+    case TOK_EQ:    code = OP_EQ; break;
+    case TOK_NE:    code = OP_NE; break;
+    case TOK_LT:    code = OP_LT; break;
+    case TOK_LE:    code = OP_LE; break;
+    case TOK_GT:    code = OP_GT; break;
+    case TOK_GE:    code = OP_GE; break;
+    default:
+        throw EvalError(std::string("unsupported binary operator ") + Lexeme(op));
+    }
+    compile(*expr.left());
+    compile(*expr.right());
+    emit(code);
+    pop();
+}
+
+void Compiler::visit_tenary(const TenaryExpr& expr)
+{
+    compile(*expr.operand1());
+    size_t to_false = emit(OP_JUMP_IF_FALSE);
+    pop();
+    compile(*expr.operand2());
+    size_t to_end = emit(OP_JUMP);
+    patch(to_false);
+    /// only one branch runs, the other starts from the same depth
+    pop();
+    compile(*expr.operand3());
+    patch(to_end);
+}
+
+void Compiler::finish()
+{
+    emit(OP_RETURN);
+}
+}  // namespace
+
+Program compile(const Expr& expr)
+{
+    Program program;
+    Compiler compiler(program);
+    compiler.compile(expr);
+    compiler.finish();
+    return program;
+}
+
+void Vm::bind(const Program& program, Bindings& bindings)
+{
+    slots_.clear();
+    for (auto& name : program.slots) {
+        auto* values = bindings.find(name);
+        if (values && !values->empty()) {
+            slots_.push_back(Slot{ values->data(), values->size(), &name });
+        } else {
+            /// reported only if the program really reads it
+            slots_.push_back(Slot{ nullptr, 0, &name });
+        }
+    }
+    bindings_ = &bindings;
+    stack_.resize(program.max_stack);
+}
+
+Vm::Slot& Vm::checked_slot(uint32_t slot)
+{
+    auto& s = slots_[slot];
+    if (s.size == 0) {
+        throw EvalError("unbound variable '" + *s.name + "'");
+    }
+    return s;
+}
+
+double* Vm::written_slot(uint32_t slot)
+{
+    auto& s = slots_[slot];
+    if (s.size == 0) {
+        auto& values = bindings_->get_or_add(*s.name);
+        s.data = values.data();
+        s.size = values.size();
+    }
+    return s.data;
+}
+
+double Vm::run(const Program& program)
+{
+    const Instr* code = program.code.data();
+    const double* consts = program.consts.data();
+    double* sp = stack_.data();   // next free entry
+    size_t pc = 0;
+
+    for (;;) {
+        const Instr& instr = code[pc++];
+        switch (instr.op) {
+        case OP_CONST:
+            *sp++ = consts[instr.arg];
+            break;
+        case OP_LOAD:
+            *sp++ = checked_slot(instr.arg).data[0];
+            break;
+        case OP_STORE:
+            written_slot(instr.arg)[0] = sp[-1];
+            break;
+        case OP_LOAD_INDEX: {
+            auto& s = checked_slot(instr.arg);
+            sp[-1] = s.data[to_index(sp[-1], s.size)];
+            break;
+        }
+        case OP_STORE_INDEX: {
+            auto& s = checked_slot(instr.arg);
+            double index = *--sp;
+            s.data[to_index(index, s.size)] = sp[-1];
+            break;
+        }
+        case OP_PRE_INC:
+            *sp++ = ++written_slot(instr.arg)[0];
+            break;
+        case OP_PRE_DEC:
+            *sp++ = --written_slot(instr.arg)[0];
+            break;
+        case OP_POST_INC:
+            *sp++ = written_slot(instr.arg)[0]++;
+            break;
+        case OP_POST_DEC:
+            *sp++ = written_slot(instr.arg)[0]--;
+            break;
+        case OP_PRE_INC_INDEX: {
+            auto& s = checked_slot(instr.arg);
+            sp[-1] = ++s.data[to_index(sp[-1], s.size)];
+            break;
+        }
+        case OP_PRE_DEC_INDEX: {
+            auto& s = checked_slot(instr.arg);
+            sp[-1] = --s.data[to_index(sp[-1], s.size)];
+            break;
+        }
+        case OP_POST_INC_INDEX: {
+            auto& s = checked_slot(instr.arg);
+            sp[-1] = s.data[to_index(sp[-1], s.size)]++;
+            break;
+        }
+        case OP_POST_DEC_INDEX: {
+            auto& s = checked_slot(instr.arg);
+            sp[-1] = s.data[to_index(sp[-1], s.size)]--;
+            break;
+        }
+        case OP_NEG:
+            sp[-1] = -sp[-1];
+            break;
+        case OP_BOOL:
+            sp[-1] = sp[-1] != 0;
+            break;
+        case OP_ADD: sp--; sp[-1] = sp[-1] + sp[0]; break;
+        case OP_SUB: sp--; sp[-1] = sp[-1] - sp[0]; break;
+        case OP_MUL: sp--; sp[-1] = sp[-1] * sp[0]; break;
+        case OP_DIV: sp--; sp[-1] = sp[-1] / sp[0]; break;
+        case OP_EQ:  sp--; sp[-1] = sp[-1] == sp[0]; break;
+        case OP_NE:  sp--; sp[-1] = sp[-1] != sp[0]; break;
+        case OP_LT:  sp--; sp[-1] = sp[-1] < sp[0]; break;
+        case OP_LE:  sp--; sp[-1] = sp[-1] <= sp[0]; break;
+        case OP_GT:  sp--; sp[-1] = sp[-1] > sp[0]; break;
+        case OP_GE:  sp--; sp[-1] = sp[-1] >= sp[0]; break;
+        case OP_JUMP:
+            pc = instr.arg;
+            break;
+        case OP_JUMP_IF_FALSE:
+            if (*--sp == 0) {
+                pc = instr.arg;
+            }
+            break;
+        case OP_JUMP_IF_FALSE_OR_POP:
+            if (sp[-1] == 0) {
+                pc = instr.arg;
+            } else {
+                sp--;
+            }
+            break;
+        case OP_JUMP_IF_TRUE_OR_POP:
+            if (sp[-1] != 0) {
+                pc = instr.arg;
+            } else {
+                sp--;
+            }
+            break;
+        case OP_RETURN:
+            return sp[-1];
+        }
+    }
+}
+}  // namespace pp_expr
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "ast.h"
+#include "eval.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pp_expr
+{
+enum OpCode : uint8_t {
+    OP_CONST,               // push consts[arg]
+    OP_LOAD,                // push slot[arg][0]
+    OP_STORE,               // slot[arg][0] = top, value stays on stack
+    OP_LOAD_INDEX,          // pop i, push slot[arg][i]
+    OP_STORE_INDEX,         // pop i, slot[arg][i] = top, value stays on stack
+    OP_PRE_INC,             // ++slot[arg][0], push new value
+    OP_PRE_DEC,
+    OP_POST_INC,            // push slot[arg][0], then increment
+    OP_POST_DEC,
+    OP_PRE_INC_INDEX,       // same as above on slot[arg][pop i]
+    OP_PRE_DEC_INDEX,
+    OP_POST_INC_INDEX,
+    OP_POST_DEC_INDEX,
+    OP_NEG,
+    OP_BOOL,                // top = top != 0
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_JUMP,                // pc = arg
+    OP_JUMP_IF_FALSE,       // pop c, if c == 0: pc = arg
+    OP_JUMP_IF_FALSE_OR_POP,// if top == 0: pc = arg, else pop
+    OP_JUMP_IF_TRUE_OR_POP, // if top != 0: pc = arg, else pop
+    OP_RETURN,              // return top
+};
+
+struct Instr {
+    OpCode op;
+    uint32_t arg;
+};
+
+const char* OpCodeName(OpCode op);
+
+/// compiled expression, immutable after compile() so one program can be
+/// run by many threads, each with its own Vm
+struct Program {
+    std::vector<Instr> code;
+    std::vector<double> consts;
+    /// variable name of each slot
+    std::vector<std::string> slots;
+    /// slots written by `=` `++` `--`, created by the first write when unbound
+    std::vector<bool> slot_written;
+    size_t max_stack{0};
+
+    /// slot index of `name`, -1 if the expression doesn't use it
+    int slot_of(const std::string& name) const;
+};
+
+/// compile `expr` to bytecode, throws EvalError for operators the
+/// evaluator would reject (`*`, `&`, assignment to a non variable, ...)
+Program compile(const Expr& expr);
+
+/// disassemble, one instruction per line
+std::ostream& operator <<(std::ostream& os, const Program& program);
+
+/// per-thread execution state: value stack and slots resolved to storage
+class Vm {
+public:
+    /// resolve program slots to variables in `bindings`; must be called
+    /// again if a bound variable is resized or bindings are replaced.
+    /// Unbound or empty variables throw when read, as in evaluate(), and
+    /// are created in `bindings` when written
+    void bind(const Program& program, Bindings& bindings);
+
+    /// run a program previously bound
+    double run(const Program& program);
+
+    /// storage of slot `slot`, to update inputs between runs; null if unbound
+    double* slot_data(size_t slot) const { return slots_[slot].data; }
+private:
+    struct Slot {
+        double* data;
+        size_t size;
+        const std::string* name;
+    };
+
+    Slot& checked_slot(uint32_t slot);
+    /// scalar a store or ++/-- writes to, created on first write
+    double* written_slot(uint32_t slot);
+
+    std::vector<double> stack_;
+    std::vector<Slot> slots_;
+    Bindings* bindings_{nullptr};
+};
+}  // namespace pp_expr
@@ -0,0 +1,493 @@
+#include "closure.h"
+#include "visitor.h"
+
+#include <array>
+#include <utility>
+
+namespace pp_expr
+{
+namespace
+{
+using Node = ClosureProgram::Node;
+using Fn = ClosureProgram::Fn;
+using Operand = ClosureProgram::Operand;
+using Kind = ClosureProgram::OperandKind;
+
+constexpr Kind CONST = ClosureProgram::OPERAND_CONST;
+constexpr Kind SLOT = ClosureProgram::OPERAND_SLOT;
+constexpr Kind NODE = ClosureProgram::OPERAND_NODE;
+
+template <Kind K>
+inline double get(const Operand& operand)
+{
+    if constexpr (K == CONST) {
+        return operand.value;
+    } else if constexpr (K == SLOT) {
+        return *operand.slot;
+    } else {
+        return operand.node->fn(operand.node);
+    }
+}
+
+/// node functions, one instantiation per operator and operand kinds
+
+template <Kind A>
+struct Leaf {
+    static double run(const Node* n) { return get<A>(n->a); }
+};
+
+template <Kind A>
+struct Negate {
+    static double run(const Node* n) { return -get<A>(n->a); }
+};
+
+template <TokenType op, Kind L, Kind R>
+struct Binary {
+    static double run(const Node* n) {
+        if constexpr (op == TOK_AND) {
+            return get<L>(n->a) != 0 && get<R>(n->b) != 0;
+        } else if constexpr (op == TOK_OR) {
+            return get<L>(n->a) != 0 || get<R>(n->b) != 0;
+        } else {
+            double left = get<L>(n->a);
+            return apply_binary(op, left, get<R>(n->b));
+        }
+    }
+};
+
+template <Kind C, Kind T, Kind F>
+struct Tenary {
+    static double run(const Node* n) {
+        return get<C>(n->a) != 0 ? get<T>(n->b) : get<F>(n->c);
+    }
+};
+
+/// a: variable data, b: index
+template <Kind I>
+struct Index {
+    static double run(const Node* n) {
+        return n->a.slot[to_index(get<I>(n->b), n->size)];
+    }
+};
+
+/// a: scalar variable, b: value
+template <Kind V>
+struct Assign {
+    static double run(const Node* n) { return *n->a.slot = get<V>(n->b); }
+};
+
+/// a: variable data, b: value, c: index; value first, as evaluate() does
+template <Kind V, Kind I>
+struct AssignIndex {
+    static double run(const Node* n) {
+        double value = get<V>(n->b);
+        return n->a.slot[to_index(get<I>(n->c), n->size)] = value;
+    }
+};
+
+/// ++ and --, prefix or postfix; a: scalar variable
+template <bool prefix, int delta>
+struct Step {
+    static double run(const Node* n) {
+        double old = *n->a.slot;
+        *n->a.slot = old + delta;
+        return prefix ? old + delta : old;
+    }
+};
+
+/// same on an element; a: variable data, b: index
+template <bool prefix, int delta, Kind I>
+struct StepIndex {
+    static double run(const Node* n) {
+        double& cell = n->a.slot[to_index(get<I>(n->b), n->size)];
+        double old = cell;
+        cell = old + delta;
+        return prefix ? old + delta : old;
+    }
+};
+
+/// variables unbound when the program was built, a: the variable
+
+[[noreturn]] void throw_unbound(const std::string& name)
+{
+    throw EvalError("unbound variable '" + name + "'");
+}
+
+std::vector<double>& late_array(const Operand& a)
+{
+    auto* values = a.late->bindings->find(a.late->name);
+    if (!values) {
+        throw_unbound(a.late->name);
+    }
+    return *values;
+}
+
+double& late_scalar(const Operand& a)
+{
+    return a.late->bindings->get_or_add(a.late->name)[0];
+}
+
+double late_read(const Node* n)
+{
+    auto* values = n->a.late->bindings->find(n->a.late->name);
+    if (!values || values->empty()) {
+        throw_unbound(n->a.late->name);
+    }
+    return (*values)[0];
+}
+
+/// b: index
+template <Kind I>
+struct LateIndex {
+    static double run(const Node* n) {
+        auto& values = late_array(n->a);
+        return values[to_index(get<I>(n->b), values.size())];
+    }
+};
+
+/// b: value
+template <Kind V>
+struct LateAssign {
+    static double run(const Node* n) {
+        double value = get<V>(n->b);
+        return late_scalar(n->a) = value;
+    }
+};
+
+/// b: value, c: index
+template <Kind V, Kind I>
+struct LateAssignIndex {
+    static double run(const Node* n) {
+        double value = get<V>(n->b);
+        double i = get<I>(n->c);
+        auto& values = late_array(n->a);
+        return values[to_index(i, values.size())] = value;
+    }
+};
+
+template <bool prefix, int delta>
+struct LateStep {
+    static double run(const Node* n) {
+        double& cell = late_scalar(n->a);
+        double old = cell;
+        cell = old + delta;
+        return prefix ? old + delta : old;
+    }
+};
+
+/// b: index
+template <bool prefix, int delta, Kind I>
+struct LateStepIndex {
+    static double run(const Node* n) {
+        double i = get<I>(n->b);
+        auto& values = late_array(n->a);
+        double& cell = values[to_index(i, values.size())];
+        double old = cell;
+        cell = old + delta;
+        return prefix ? old + delta : old;
+    }
+};
+
+/// function of a node template for runtime operand kinds
+template <template <Kind> class T>
+Fn pick(Kind a)
+{
+    static constexpr Fn table[] = { &T<CONST>::run, &T<SLOT>::run, &T<NODE>::run };
+    return table[a];
+}
+
+template <template <Kind, Kind> class T, size_t... I>
+constexpr std::array<Fn, 9> table2(std::index_sequence<I...>)
+{
+    return { { &T<Kind(I / 3), Kind(I % 3)>::run... } };
+}
+
+template <template <Kind, Kind> class T>
+Fn pick(Kind a, Kind b)
+{
+    static constexpr auto table = table2<T>(std::make_index_sequence<9>());
+    return table[a * 3 + b];
+}
+
+template <template <Kind, Kind, Kind> class T, size_t... I>
+constexpr std::array<Fn, 27> table3(std::index_sequence<I...>)
+{
+    return { { &T<Kind(I / 9), Kind(I / 3 % 3), Kind(I % 3)>::run... } };
+}
+
+template <template <Kind, Kind, Kind> class T>
+Fn pick(Kind a, Kind b, Kind c)
+{
+    static constexpr auto table = table3<T>(std::make_index_sequence<27>());
+    return table[a * 9 + b * 3 + c];
+}
+
+template <TokenType op>
+struct BinaryOf {
+    template <Kind L, Kind R>
+    using type = Binary<op, L, R>;
+};
+
+template <bool prefix, int delta>
+struct StepIndexOf {
+    template <Kind I>
+    using type = StepIndex<prefix, delta, I>;
+};
+
+template <bool prefix, int delta>
+struct LateStepIndexOf {
+    template <Kind I>
+    using type = LateStepIndex<prefix, delta, I>;
+};
+
+size_t count_nodes(const Expr& expr)
+{
+    size_t count = 1;
+    visit_expr(expr, [&count](auto& node) {
+        using T = std::decay_t<decltype(node)>;
+        if constexpr (std::is_base_of_v<UnaryExpr, T>) {
+            count += count_nodes(*node.operand());
+        } else if constexpr (std::is_same_v<T, BinaryExpr>) {
+            count += count_nodes(*node.left()) + count_nodes(*node.right());
+        } else if constexpr (std::is_same_v<T, TenaryExpr>) {
+            count += count_nodes(*node.operand1()) + count_nodes(*node.operand2())
+                + count_nodes(*node.operand3());
+        }
+    });
+    return count;
+}
+}  // namespace
+
+/// how a lowered subexpression is passed to its parent
+struct ClosureOperand {
+    Kind kind;
+    Operand operand;
+};
+
+class ClosureLowering : public ExprVisitor<ClosureLowering, ClosureOperand> {
+public:
+    ClosureLowering(ClosureProgram& program, Bindings& bindings)
+        : program_(program), bindings_(bindings) {}
+
+    ClosureOperand visit_number(const Number& expr) { return constant(expr.value()); }
+    ClosureOperand visit_ident(const Ident& expr);
+    ClosureOperand visit_unary(const UnaryExpr& expr);
+    ClosureOperand visit_postfix_unary(const PostfixUnaryExpr& expr);
+    ClosureOperand visit_binary(const BinaryExpr& expr);
+    ClosureOperand visit_tenary(const TenaryExpr& expr);
+
+    /// the root has to be a node even when it is a constant or variable
+    const Node* root(const ClosureOperand& value) {
+        if (value.kind == NODE) {
+            return value.operand.node;
+        }
+        return add(pick<Leaf>(value.kind), value.operand).operand.node;
+    }
+private:
+    static ClosureOperand constant(double value) {
+        ClosureOperand result{ CONST, {} };
+        result.operand.value = value;
+        return result;
+    }
+
+    ClosureOperand add(Fn fn, Operand a, Operand b = {}, Operand c = {}, size_t size = 0) {
+        /// reserved up front, node addresses never change
+        program_.nodes_.push_back(Node{ fn, a, b, c, size });
+        ClosureOperand result{ NODE, {} };
+        result.operand.node = &program_.nodes_.back();
+        return result;
+    }
+
+    /// operand naming a variable: its data if bound and not empty,
+    /// otherwise a late variable looked up when it runs
+    struct Variable {
+        Operand operand;
+        size_t size;
+        bool late;
+    };
+    Variable variable(const std::string& name) {
+        Variable result{ {}, 0, false };
+        auto* values = bindings_.find(name);
+        if (!values || values->empty()) {
+            program_.late_.push_back({ name, &bindings_ });
+            result.operand.late = &program_.late_.back();
+            result.late = true;
+        } else {
+            result.operand.slot = values->data();
+            result.size = values->size();
+        }
+        return result;
+    }
+
+    /// variable `expr` must name, for `=` `++` `--`
+    const std::string& scalar(const Expr& expr) {
+        if (auto* ident = dyn_expr_cast<Ident>(&expr)) {
+            return ident->value();
+        }
+        throw EvalError("expression is not assignable");
+    }
+
+    /// `x[i]` target: variable x, null if it is unbound
+    const BinaryExpr* indexed(const Expr& expr) {
+        auto* index = dyn_expr_cast<BinaryExpr>(&expr);
+        if (index && index->op().token_type == TOK_LSQUAR && isa<Ident>(*index->left())) {
+            return index;
+        }
+        return nullptr;
+    }
+
+    ClosureOperand step(const Expr& target, bool prefix, bool increment);
+
+    ClosureProgram& program_;
+    Bindings& bindings_;
+};
+
+ClosureOperand ClosureLowering::visit_ident(const Ident& expr)
+{
+    Variable var = variable(expr.value());
+    if (var.late) {
+        return add(&late_read, var.operand);
+    }
+    return ClosureOperand{ SLOT, var.operand };
+}
+
+ClosureOperand ClosureLowering::step(const Expr& target, bool prefix, bool increment)
+{
+    if (auto* index = indexed(target)) {
+        ClosureOperand i = visit(*index->right());
+        Variable var = variable(expr_cast<Ident>(*index->left()).value());
+        if (var.late) {
+            Fn fn = prefix
+                ? (increment ? pick<LateStepIndexOf<true, 1>::type>(i.kind) : pick<LateStepIndexOf<true, -1>::type>(i.kind))
+                : (increment ? pick<LateStepIndexOf<false, 1>::type>(i.kind) : pick<LateStepIndexOf<false, -1>::type>(i.kind));
+            return add(fn, var.operand, i.operand);
+        }
+        Fn fn = prefix
+            ? (increment ? pick<StepIndexOf<true, 1>::type>(i.kind) : pick<StepIndexOf<true, -1>::type>(i.kind))
+            : (increment ? pick<StepIndexOf<false, 1>::type>(i.kind) : pick<StepIndexOf<false, -1>::type>(i.kind));
+        return add(fn, var.operand, i.operand, {}, var.size);
+    }
+    Variable var = variable(scalar(target));
+    Fn fn = var.late
+        ? (prefix
+            ? (increment ? &LateStep<true, 1>::run : &LateStep<true, -1>::run)
+            : (increment ? &LateStep<false, 1>::run : &LateStep<false, -1>::run))
+        : (prefix
+            ? (increment ? &Step<true, 1>::run : &Step<true, -1>::run)
+            : (increment ? &Step<false, 1>::run : &Step<false, -1>::run));
+    return add(fn, var.operand);
+}
+
+ClosureOperand ClosureLowering::visit_unary(const UnaryExpr& expr)
+{
+    switch (expr.op().token_type) {
+    case TOK_PLUS:
+        return visit(*expr.operand());
+    case TOK_MINUS: {
+        ClosureOperand operand = visit(*expr.operand());
+        if (operand.kind == CONST) {
+            return constant(-operand.operand.value);
+        }
+        return add(pick<Negate>(operand.kind), operand.operand);
+    }
+    case TOK_INC:
+        return step(*expr.operand(), true, true);
+    case TOK_DEC:
+        return step(*expr.operand(), true, false);
+    default:
+        throw EvalError(std::string("unsupported prefix operator ") + Lexeme(expr.op().token_type));
+    }
+}
+
+ClosureOperand ClosureLowering::visit_postfix_unary(const PostfixUnaryExpr& expr)
+{
+    switch (expr.op().token_type) {
+    case TOK_INC:
+        return step(*expr.operand(), false, true);
+    case TOK_DEC:
+        return step(*expr.operand(), false, false);
+    default:
+        throw EvalError(std::string("unsupported postfix operator ") + Lexeme(expr.op().token_type));
+    }
+}
+
+ClosureOperand ClosureLowering::visit_binary(const BinaryExpr& expr)
+{
+    auto op = expr.op().token_type;
+    if (op == TOK_ASSIGN) {
+        /// right operand first, as C++17 sequences `a = b`
+        ClosureOperand value = visit(*expr.right());
+        if (auto* index = indexed(*expr.left())) {
+            ClosureOperand i = visit(*index->right());
+            Variable var = variable(expr_cast<Ident>(*index->left()).value());
+            if (var.late) {
+                return add(pick<LateAssignIndex>(value.kind, i.kind), var.operand, value.operand, i.operand);
+            }
+            return add(pick<AssignIndex>(value.kind, i.kind), var.operand, value.operand, i.operand,
+                var.size);
+        }
+        Variable var = variable(scalar(*expr.left()));
+        if (var.late) {
+            return add(pick<LateAssign>(value.kind), var.operand, value.operand);
+        }
+        return add(pick<Assign>(value.kind), var.operand, value.operand);
+    }
+    if (op == TOK_LSQUAR) {
+        if (!isa<Ident>(*expr.left())) {
+            throw EvalError("only variables can be indexed");
+        }
+        ClosureOperand i = visit(*expr.right());
+        Variable var = variable(expr_cast<Ident>(*expr.left()).value());
+        if (var.late) {
+            return add(pick<LateIndex>(i.kind), var.operand, i.operand);
+        }
+        return add(pick<Index>(i.kind), var.operand, i.operand, {}, var.size);
+    }
+
+    ClosureOperand left = visit(*expr.left());
+    ClosureOperand right = visit(*expr.right());
+    Fn fn = nullptr;
+    switch (op) {
+    case TOK_PLUS:  fn = pick<BinaryOf<TOK_PLUS>::type>(left.kind, right.kind); break;
+    case TOK_MINUS: fn = pick<BinaryOf<TOK_MINUS>::type>(left.kind, right.kind); break;
+    case TOK_STAR:  fn = pick<BinaryOf<TOK_STAR>::type>(left.kind, right.kind); break;
+    case TOK_SLASH: fn = pick<BinaryOf<TOK_SLASH>::type>(left.kind, right.kind); break;
+    case TOK_EQ:    fn = pick<BinaryOf<TOK_EQ>::type>(left.kind, right.kind); break;
+    case TOK_NE:    fn = pick<BinaryOf<TOK_NE>::type>(left.kind, right.kind); break;
+    case TOK_LT:    fn = pick<BinaryOf<TOK_LT>::type>(left.kind, right.kind); break;
+    case TOK_LE:    fn = pick<BinaryOf<TOK_LE>::type>(left.kind, right.kind); break;
+    case TOK_GT:    fn = pick<BinaryOf<TOK_GT>::type>(left.kind, right.kind); break;
+    case TOK_GE:    fn = pick<BinaryOf<TOK_GE>::type>(left.kind, right.kind); break;
+    case TOK_AND:   fn = pick<BinaryOf<TOK_AND>::type>(left.kind, right.kind); break;
+    case TOK_OR:    fn = pick<BinaryOf<TOK_OR>::type>(left.kind, right.kind); break;
+    default:
+        throw EvalError(std::string("unsupported binary operator ") + Lexeme(op));
+    }
+    if (left.kind == CONST && right.kind == CONST) {
+        /// no side effects in either operand, fold now
+        Node node{ fn, left.operand, right.operand, {}, 0 };
+        return constant(fn(&node));
+    }
+    return add(fn, left.operand, right.operand);
+}
+
+ClosureOperand ClosureLowering::visit_tenary(const TenaryExpr& expr)
+{
+    ClosureOperand cond = visit(*expr.operand1());
+    if (cond.kind == CONST) {
+        /// the other branch never runs
+        return visit(cond.operand.value != 0 ? *expr.operand2() : *expr.operand3());
+    }
+    ClosureOperand then = visit(*expr.operand2());
+    ClosureOperand otherwise = visit(*expr.operand3());
+    return add(pick<Tenary>(cond.kind, then.kind, otherwise.kind),
+        cond.operand, then.operand, otherwise.operand);
+}
+
+ClosureProgram::ClosureProgram(const Expr& expr, Bindings& bindings)
+{
+    nodes_.reserve(count_nodes(expr) + 1);
+    ClosureLowering lowering(*this, bindings);
+    root_ = lowering.root(lowering.visit(expr));
+}
+}  // namespace pp_expr
@@ -0,0 +1,42 @@
+#include "diagnostic.h"
+
+namespace pp_expr
+{
+const char* ParseErrorName(ParseError error)
+{
+    switch (error) {
+    case ParseError::None: return "none";
+    case ParseError::UnexpectedEnd: return "unexpected-end";
+    case ParseError::UnexpectedToken: return "unexpected-token";
+    case ParseError::InvalidToken: return "invalid-token";
+    case ParseError::MissingToken: return "missing-token";
+    case ParseError::TooDeep: return "too-deep";
+    }
+    return "";
+}
+
+static std::string quoted(std::string_view text)
+{
+    return "'" + std::string(text) + "'";
+}
+
+std::string Diagnostic::message() const
+{
+    switch (code) {
+    case ParseError::None:
+        return "no error";
+    case ParseError::UnexpectedEnd:
+        return "unexpected end of input";
+    case ParseError::UnexpectedToken:
+        return "unexpected token " + quoted(got.lexeme());
+    case ParseError::InvalidToken:
+        return "invalid character " + quoted(got.lexeme());
+    case ParseError::MissingToken:
+        return "expected " + quoted(Lexeme(expected)) + ", got "
+            + (got.token_type == TOK_COUNT ? std::string("end of input") : quoted(got.lexeme()));
+    case ParseError::TooDeep:
+        return "expression nested too deeply";
+    }
+    return "";
+}
+}  // namespace pp_expr
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ast.h"
+#include "tokens.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace pp_expr
+{
+enum class ParseError : uint8_t {
+    None,
+    UnexpectedEnd,    ///< input ended where an operand was needed
+    UnexpectedToken,  ///< token can't start an operand, or follows a complete expression
+    InvalidToken,     ///< character the lexer didn't recognize
+    MissingToken,     ///< closing ')', ']' or ':' not found
+    TooDeep,          ///< nesting exceeds the parser's max depth
+};
+
+const char* ParseErrorName(ParseError error);
+
+/// what went wrong and where; plain data, the message is only formatted on
+/// request so rejecting input stays cheap
+struct Diagnostic {
+    ParseError code{ParseError::None};
+    /// index of the offending token, the token count at end of input
+    size_t token_index{0};
+    /// offending token; at end of input it is TOK_COUNT with an empty lexeme
+    /// just past the last token
+    Token got{TOK_COUNT, {}};
+    /// the token that was required, for MissingToken
+    TokenType expected{TOK_COUNT};
+
+    explicit operator bool() const { return code != ParseError::None; }
+
+    /// byte offset of the offending token in the `source` it was lexed from
+    size_t offset(std::string_view source) const {
+        return got.offset(source);
+    }
+
+    /// for example: expected ')', got end of input
+    std::string message() const;
+};
+
+/// one parsed expression, `ast` is meaningful only when ok()
+struct ParseResult {
+    Expr_t ast;
+    Diagnostic error;
+
+    bool ok() const { return !error; }
+};
+}  // namespace pp_expr
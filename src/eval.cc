@@ -0,0 +1,174 @@
+#include "eval.h"
+#include "visitor.h"
+
+#include <cmath>
+
+namespace pp_expr
+{
+size_t to_index(double index, size_t size)
+{
+    if (!(index >= 0) || index >= static_cast<double>(size) || index != std::floor(index)) {
+        throw EvalError("index " + std::to_string(index) + " out of range " + std::to_string(size));
+    }
+    return static_cast<size_t>(index);
+}
+
+ResolvedBindings::ResolvedBindings(const SymbolTable& symbols, Bindings& bindings)
+    : symbols_(symbols), bindings_(bindings), slots_(symbols.size())
+{
+    for (uint32_t id = 0; id < slots_.size(); id++) {
+        slots_[id] = bindings_.find(symbols_.name(id));
+    }
+}
+
+std::vector<double>* ResolvedBindings::resolve(const Ident& ident)
+{
+    auto& symbol = ident.symbol();
+    uint32_t id = symbol.id;
+    if (symbol.table != symbols_.tag() || id >= symbols_.size()) {
+        return bindings_.find(ident.value());
+    }
+    if (id >= slots_.size()) {
+        slots_.resize(symbols_.size(), nullptr);
+    }
+    return slots_[id] = bindings_.find(ident.value());
+}
+
+std::vector<double>& ResolvedBindings::get_or_add(const Ident& ident)
+{
+    auto* values = find(ident);
+    if (values && !values->empty()) {
+        return *values;
+    }
+    auto& added = bindings_.get_or_add(ident.value());
+    auto& symbol = ident.symbol();
+    if (symbol.table == symbols_.tag() && symbol.id < slots_.size()) {
+        slots_[symbol.id] = &added;
+    }
+    return added;
+}
+
+namespace
+{
+class Evaluator : public ExprVisitor<Evaluator, double> {
+public:
+    explicit Evaluator(Bindings& bindings) : bindings_(bindings) {}
+    explicit Evaluator(ResolvedBindings& slots) : bindings_(slots.bindings()), slots_(&slots) {}
+
+    double visit_number(const Number& expr) { return expr.value(); }
+    double visit_ident(const Ident& expr);
+    double visit_unary(const UnaryExpr& expr);
+    double visit_postfix_unary(const PostfixUnaryExpr& expr);
+    double visit_binary(const BinaryExpr& expr);
+    double visit_tenary(const TenaryExpr& expr) {
+        return visit(*expr.operand1()) != 0
+            ? visit(*expr.operand2())
+            : visit(*expr.operand3());
+    }
+private:
+    double& lvalue(const Expr& expr);
+
+    std::vector<double>* find(const Ident& ident) {
+        return slots_ ? slots_->find(ident) : bindings_.find(ident.value());
+    }
+    std::vector<double>& get_or_add(const Ident& ident) {
+        return slots_ ? slots_->get_or_add(ident) : bindings_.get_or_add(ident.value());
+    }
+
+    Bindings& bindings_;
+    ResolvedBindings* slots_{nullptr};
+};
+
+double Evaluator::visit_ident(const Ident& expr)
+{
+    auto* values = find(expr);
+    if (!values || values->empty()) {
+        throw EvalError("unbound variable '" + expr.value() + "'");
+    }
+    return (*values)[0];
+}
+
+/// storage an assignment or increment writes to: `x` or `x[i]`
+double& Evaluator::lvalue(const Expr& expr)
+{
+    if (auto* ident = dyn_expr_cast<Ident>(&expr)) {
+        return get_or_add(*ident)[0];
+    }
+    if (auto* index = dyn_expr_cast<BinaryExpr>(&expr)) {
+        if (index->op().token_type == TOK_LSQUAR && isa<Ident>(*index->left())) {
+            auto& ident = expr_cast<Ident>(*index->left());
+            double i = visit(*index->right());
+            auto* values = find(ident);
+            if (!values) {
+                throw EvalError("unbound variable '" + ident.value() + "'");
+            }
+            return (*values)[to_index(i, values->size())];
+        }
+    }
+    throw EvalError("expression is not assignable");
+}
+
+double Evaluator::visit_unary(const UnaryExpr& expr)
+{
+    switch (expr.op().token_type) {
+    case TOK_PLUS:  return visit(*expr.operand());
+    case TOK_MINUS: return -visit(*expr.operand());
+    case TOK_INC:   return ++lvalue(*expr.operand());
+    case TOK_DEC:   return --lvalue(*expr.operand());
+    default:
+        throw EvalError(std::string("unsupported prefix operator ") + Lexeme(expr.op().token_type));
+    }
+}
+
+double Evaluator::visit_postfix_unary(const PostfixUnaryExpr& expr)
+{
+    switch (expr.op().token_type) {
+    case TOK_INC:   return lvalue(*expr.operand())++;
+    case TOK_DEC:   return lvalue(*expr.operand())--;
+    default:
+        throw EvalError(std::string("unsupported postfix operator ") + Lexeme(expr.op().token_type));
+    }
+}
+
+double Evaluator::visit_binary(const BinaryExpr& expr)
+{
+    auto op = expr.op().token_type;
+    switch (op) {
+    case TOK_AND:
+        return visit(*expr.left()) != 0 && visit(*expr.right()) != 0;
+    case TOK_OR:
+        return visit(*expr.left()) != 0 || visit(*expr.right()) != 0;
+    case TOK_ASSIGN: {
+        /// right operand first, as C++17 sequences `a = b`
+        double value = visit(*expr.right());
+        return lvalue(*expr.left()) = value;
+    }
+    case TOK_LSQUAR: {
+        if (!isa<Ident>(*expr.left())) {
+            throw EvalError("only variables can be indexed");
+        }
+        auto& ident = expr_cast<Ident>(*expr.left());
+        auto* values = find(ident);
+        if (!values) {
+            throw EvalError("unbound variable '" + ident.value() + "'");
+        }
+        return (*values)[to_index(visit(*expr.right()), values->size())];
+    }
+    default: {
+        double left = visit(*expr.left());
+        return apply_binary(op, left, visit(*expr.right()));
+    }
+    }
+}
+}  // namespace
+
+double evaluate(const Expr& expr, Bindings& bindings)
+{
+    return Evaluator(bindings).visit(expr);
+}
+
+double evaluate(const Expr& expr, ResolvedBindings& bindings)
+{
+    return Evaluator(bindings).visit(expr);
+}
+}  // namespace pp_expr
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ast.h"
+#include "symbols.h"
+#include "tokens.h"
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pp_expr
+{
+/// raised when an expression can't be evaluated: unbound variable, index out
+/// of range, non-assignable operand, unsupported operator
+struct EvalError : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+/// variables visible to evaluation, every variable is an array of doubles
+/// and a scalar is an array of one element: `x` reads x[0]
+class Bindings {
+public:
+    void set(const std::string& name, double value) { vars_[name].assign(1, value); }
+    void set(const std::string& name, std::vector<double> values) { vars_[name] = std::move(values); }
+
+    std::vector<double>* find(const std::string& name) {
+        auto it = vars_.find(name);
+        return it == vars_.end() ? nullptr : &it->second;
+    }
+    const std::vector<double>* find(const std::string& name) const {
+        auto it = vars_.find(name);
+        return it == vars_.end() ? nullptr : &it->second;
+    }
+    /// find or create a scalar, used by assignment
+    std::vector<double>& get_or_add(const std::string& name) {
+        auto& values = vars_[name];
+        if (values.empty()) {
+            values.assign(1, 0.0);
+        }
+        return values;
+    }
+
+    size_t size() const { return vars_.size(); }
+private:
+    std::unordered_map<std::string, std::vector<double>> vars_;
+};
+
+/// variables of `bindings` looked up once per symbol of `symbols`, so trees
+/// parsed through a SymbolBuilder on the same table are evaluated without
+/// hashing names. Slots point into `bindings`, which never moves a variable
+/// once added; both must outlive this.
+class ResolvedBindings {
+public:
+    ResolvedBindings(const SymbolTable& symbols, Bindings& bindings);
+
+    /// variable of `ident`, null if unbound; identifiers interned in
+    /// another table, or none, are looked up by name
+    std::vector<double>* find(const Ident& ident) {
+        auto& symbol = ident.symbol();
+        auto* slot = symbol.table == symbols_.tag() && symbol.id < slots_.size()
+            ? slots_[symbol.id] : nullptr;
+        return slot ? slot : resolve(ident);
+    }
+    /// find or create a scalar, used by assignment
+    std::vector<double>& get_or_add(const Ident& ident);
+
+    Bindings& bindings() { return bindings_; }
+private:
+    /// slow path: symbols interned or variables bound after construction
+    std::vector<double>* resolve(const Ident& ident);
+
+    const SymbolTable& symbols_;
+    Bindings& bindings_;
+    std::vector<std::vector<double>*> slots_;
+};
+
+/// numeric semantics of arithmetic and comparison operators, shared by every
+/// evaluation engine; comparisons yield 1 or 0
+constexpr double apply_binary(TokenType op, double left, double right)
+{
+    switch (op) {
+    case TOK_PLUS:  return left + right;
+    case TOK_MINUS: return left - right;
+    case TOK_STAR:  return left * right;
+    case TOK_SLASH: return left / right;
+    case TOK_EQ:    return left == right;
+    case TOK_NE:    return left != right;
+    case TOK_LT:    return left < right;
+    case TOK_LE:    return left <= right;
+    case TOK_GT:    return left > right;
+    case TOK_GE:    return left >= right;
+    case TOK_AND:   return left != 0 && right != 0;
+    case TOK_OR:    return left != 0 || right != 0;
+    default:
+        throw EvalError(std::string("not an arithmetic operator: ") + Lexeme(op));
+    }
+}
+
+/// convert an index value to a position in `size` elements
+size_t to_index(double index, size_t size);
+
+/// evaluate `expr` with doubles: comparisons and logical ops yield 1/0,
+/// && and || short-circuit, `=` `++` `--` write through to bindings
+/// (assigning an unbound name creates it), `a[i]` indexes an array variable;
+/// pointer operators `*` and `&` have no numeric meaning and raise EvalError
+double evaluate(const Expr& expr, Bindings& bindings);
+/// same, identifiers interned in the table of `bindings` go through their slot
+double evaluate(const Expr& expr, ResolvedBindings& bindings);
+}  // namespace pp_expr
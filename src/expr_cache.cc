@@ -0,0 +1,110 @@
+#include "expr_cache.h"
+#include "builder.h"
+#include "lexer.h"
+#include "optimize.h"
+#include "parser.h"
+
+#include <functional>
+
+namespace pp_expr
+{
+/// typical rule expressions fit in one small block
+static const size_t kEntryBlockSize = 512;
+
+std::shared_ptr<const CachedExpr> compile_cached(std::string_view source)
+{
+    auto tokens = tokenize(source);
+    if (tokens.empty()) {
+        return nullptr;
+    }
+    auto entry = std::make_shared<CachedExpr>();
+    entry->source = std::string(source);
+    entry->arena = std::make_unique<Arena>(kEntryBlockSize);
+    ArenaBuilder builder(*entry->arena);
+    Parser parser(tokens, builder);
+    auto ast = parser.parse();
+    if (parser.failed()) {
+        return nullptr;
+    }
+    entry->ast = optimize(ast, builder);
+    return entry;
+}
+
+ExprCache::ExprCache(size_t memory_budget, size_t shards)
+    : shard_budget_(memory_budget / (shards ? shards : 1))
+{
+    for (size_t i = 0; i < (shards ? shards : 1); i++) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+ExprCache::Shard& ExprCache::shard_of(std::string_view source)
+{
+    return *shards_[std::hash<std::string_view>()(source) % shards_.size()];
+}
+
+std::shared_ptr<const CachedExpr> ExprCache::get(std::string_view source)
+{
+    auto& shard = shard_of(source);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(source);
+        if (it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            hits_++;
+            return *it->second;
+        }
+    }
+
+    misses_++;
+    auto entry = compile_cached(source);
+    if (!entry) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(source);
+    if (it != shard.index.end()) {
+        /// another thread parsed it meanwhile, keep the cached one
+        return *it->second;
+    }
+    shard.lru.push_front(entry);
+    shard.index.emplace(entry->source, shard.lru.begin());
+    shard.bytes += entry->bytes();
+    evict(shard);
+    return entry;
+}
+
+void ExprCache::evict(Shard& shard)
+{
+    /// the newest entry stays even if it alone exceeds the budget
+    while (shard.bytes > shard_budget_ && shard.lru.size() > 1) {
+        auto& victim = shard.lru.back();
+        shard.bytes -= victim->bytes();
+        shard.index.erase(victim->source);
+        shard.lru.pop_back();
+        evictions_++;
+    }
+}
+
+CacheStats ExprCache::stats() const
+{
+    CacheStats stats{ hits_, misses_, evictions_, 0, 0 };
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.entries += shard->lru.size();
+        stats.bytes += shard->bytes;
+    }
+    return stats;
+}
+
+void ExprCache::clear()
+{
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->index.clear();
+        shard->lru.clear();
+        shard->bytes = 0;
+    }
+}
+}  // namespace pp_expr
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "arena.h"
+#include "ast.h"
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pp_expr
+{
+/// parsed and optimized form of one source text, immutable once cached so
+/// any number of threads may read it; `ast` lives in `arena`
+struct CachedExpr {
+    std::string source;
+    std::unique_ptr<Arena> arena;
+    Expr_t ast;
+
+    /// memory charged to the cache
+    size_t bytes() const { return sizeof(CachedExpr) + source.capacity() + arena->bytes_reserved(); }
+};
+
+struct CacheStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+/// concurrent cache from source text to its parsed form, bounded by a memory
+/// budget and evicting least recently used entries. Keys are spread over
+/// shards, each with its own lock and LRU list; parsing happens outside of
+/// any lock. Evicted entries stay valid for whoever still holds them.
+class ExprCache {
+public:
+    explicit ExprCache(size_t memory_budget, size_t shards = 16);
+
+    /// cached form of `source`, parsed and optimized on a miss;
+    /// null if `source` holds no expression or does not parse
+    std::shared_ptr<const CachedExpr> get(std::string_view source);
+
+    CacheStats stats() const;
+    void clear();
+private:
+    using Entry = std::shared_ptr<const CachedExpr>;
+
+    struct Shard {
+        std::mutex mutex;
+        /// front is most recently used
+        std::list<Entry> lru;
+        /// keys view the source owned by the entry
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        size_t bytes{0};
+    };
+
+    Shard& shard_of(std::string_view source);
+    void evict(Shard& shard);
+
+    size_t shard_budget_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+    std::atomic<size_t> evictions_{0};
+};
+
+/// parse and optimize `source` into a standalone entry, null if empty or malformed
+std::shared_ptr<const CachedExpr> compile_cached(std::string_view source);
+}  // namespace pp_expr
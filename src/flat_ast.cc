@@ -0,0 +1,109 @@
+#include "flat_ast.h"
+#include "parser.h"
+
+#include <cassert>
+
+namespace pp_expr
+{
+void FlatAst::clear()
+{
+    kinds.clear();
+    ops.clear();
+    args.clear();
+    children.clear();
+    numbers.clear();
+    idents.clear();
+}
+
+std::ostream& print(std::ostream& os, const FlatAst& ast, uint32_t node)
+{
+    switch (ast.kinds[node]) {
+    case ExprKind::Number:
+        return os << ast.number(node);
+    case ExprKind::Ident:
+        return os << ast.ident(node);
+    case ExprKind::Unary:
+        os << "(" << Lexeme(ast.ops[node]) << " ";
+        return print(os, ast, ast.child(node, 0)) << ")";
+    case ExprKind::PostfixUnary:
+        os << "(";
+        return print(os, ast, ast.child(node, 0)) << " " << Lexeme(ast.ops[node]) << ")";
+    case ExprKind::Binary:
+    case ExprKind::Tenary:
+        os << "(" << Lexeme(ast.ops[node]);
+        for (uint32_t i = 0; i < child_count(ast.kinds[node]); i++) {
+            print(os << " ", ast, ast.child(node, i));
+        }
+        return os << ")";
+    }
+    return os;
+}
+
+void FlatBuilder::emit(ExprKind kind, TokenType op, uint32_t arg)
+{
+    pending_.push_back(static_cast<uint32_t>(ast_.kinds.size()));
+    ast_.kinds.push_back(kind);
+    ast_.ops.push_back(op);
+    ast_.args.push_back(arg);
+}
+
+void FlatBuilder::emit_parent(ExprKind kind, TokenType op)
+{
+    /// operands are the most recently completed subtrees, in order
+    uint32_t count = child_count(kind);
+    assert(pending_.size() >= count);
+    auto first = static_cast<uint32_t>(ast_.children.size());
+    ast_.children.insert(ast_.children.end(), pending_.end() - count, pending_.end());
+    pending_.resize(pending_.size() - count);
+    emit(kind, op, first);
+}
+
+Expr_t FlatBuilder::number(double value)
+{
+    emit(ExprKind::Number, TOK_NUM, static_cast<uint32_t>(ast_.numbers.size()));
+    ast_.numbers.push_back(value);
+    return nullptr;
+}
+
+Expr_t FlatBuilder::ident(std::string_view name, SymbolId)
+{
+    emit(ExprKind::Ident, TOK_ID, static_cast<uint32_t>(ast_.idents.size()));
+    ast_.idents.emplace_back(name);
+    return nullptr;
+}
+
+Expr_t FlatBuilder::unary(const Token& op, const Expr_t&)
+{
+    emit_parent(ExprKind::Unary, op.token_type);
+    return nullptr;
+}
+
+Expr_t FlatBuilder::postfix_unary(const Token& op, const Expr_t&)
+{
+    emit_parent(ExprKind::PostfixUnary, op.token_type);
+    return nullptr;
+}
+
+Expr_t FlatBuilder::binary(const Token& op, const Expr_t&, const Expr_t&)
+{
+    emit_parent(ExprKind::Binary, op.token_type);
+    return nullptr;
+}
+
+Expr_t FlatBuilder::tenary(const Token& op, const Expr_t&, const Expr_t&, const Expr_t&)
+{
+    emit_parent(ExprKind::Tenary, op.token_type);
+    return nullptr;
+}
+
+void parse_flat(const std::vector<Token>& tokens, FlatAst& ast)
+{
+    ast.clear();
+    FlatBuilder builder(ast);
+    Parser parser(tokens, builder);
+    parser.parse();
+    if (parser.failed()) {
+        ast.clear();
+    }
+}
+}  // namespace pp_expr
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ast.h"
+#include "builder.h"
+#include "tokens.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pp_expr
+{
+/// expression tree stored as parallel arrays, nodes are in post-order so
+/// children always precede their parent and the root is the last node
+struct FlatAst {
+    /// per node
+    std::vector<ExprKind> kinds;
+    std::vector<TokenType> ops;     // operator, TOK_NUM/TOK_ID for leaves
+    std::vector<uint32_t> args;     // leaves: index into numbers/idents,
+                                    // others: offset of first child in children
+    /// child node indices, child_count(kind) consecutive entries per node
+    std::vector<uint32_t> children;
+    /// literal and identifier side tables
+    std::vector<double> numbers;
+    std::vector<std::string> idents;
+
+    size_t size() const { return kinds.size(); }
+    bool empty() const { return kinds.empty(); }
+    uint32_t root() const { return static_cast<uint32_t>(kinds.size() - 1); }
+
+    uint32_t child(uint32_t node, uint32_t n) const { return children[args[node] + n]; }
+    double number(uint32_t node) const { return numbers[args[node]]; }
+    const std::string& ident(uint32_t node) const { return idents[args[node]]; }
+
+    void clear();
+};
+
+inline uint32_t child_count(ExprKind kind)
+{
+    switch (kind) {
+    case ExprKind::Number:
+    case ExprKind::Ident: return 0;
+    case ExprKind::Unary:
+    case ExprKind::PostfixUnary: return 1;
+    case ExprKind::Binary: return 2;
+    case ExprKind::Tenary: return 3;
+    }
+    return 0;
+}
+
+/// print subtree rooted at `node` in the same form as Expr::visit
+std::ostream& print(std::ostream& os, const FlatAst& ast, uint32_t node);
+
+inline std::ostream& operator <<(std::ostream& os, const FlatAst& ast)
+{
+    return ast.empty() ? os : print(os, ast, ast.root());
+}
+
+/// appends parser nodes to a FlatAst instead of allocating them; the Expr_t
+/// it returns are null, children are tracked on an internal stack
+class FlatBuilder : public AstBuilder {
+public:
+    explicit FlatBuilder(FlatAst& ast) : ast_(ast) {}
+
+    Expr_t number(double value) override;
+    Expr_t ident(std::string_view name, SymbolId symbol = {}) override;
+    Expr_t unary(const Token& op, const Expr_t& operand) override;
+    Expr_t postfix_unary(const Token& op, const Expr_t& operand) override;
+    Expr_t binary(const Token& op, const Expr_t& left, const Expr_t& right) override;
+    Expr_t tenary(const Token& op, const Expr_t& operand1,
+        const Expr_t& operand2, const Expr_t& operand3) override;
+private:
+    void emit(ExprKind kind, TokenType op, uint32_t arg);
+    void emit_parent(ExprKind kind, TokenType op);
+
+    FlatAst& ast_;
+    std::vector<uint32_t> pending_;
+};
+
+/// parse `tokens` straight into `ast`, which is cleared first
+void parse_flat(const std::vector<Token>& tokens, FlatAst& ast);
+}  // namespace pp_expr
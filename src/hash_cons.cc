@@ -0,0 +1,79 @@
+#include "hash_cons.h"
+#include "visitor.h"
+
+#include <cstring>
+#include <functional>
+
+namespace pp_expr
+{
+static size_t hash_combine(size_t seed, size_t value)
+{
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+size_t HashConsBuilder::KeyHash::operator ()(const Key& key) const
+{
+    size_t h = static_cast<size_t>(key.kind) * 31 + static_cast<size_t>(key.op);
+    for (auto* child : key.children) {
+        h = hash_combine(h, std::hash<const Expr*>()(child));
+    }
+    h = hash_combine(h, std::hash<uint64_t>()(key.bits));
+    return hash_combine(h, std::hash<std::string_view>()(key.name));
+}
+
+template <typename Make>
+Expr_t HashConsBuilder::intern(Key key, Make make)
+{
+    auto it = nodes_.find(key);
+    if (it != nodes_.end()) {
+        hits_++;
+        return it->second;
+    }
+    Expr_t node = make();
+    if (key.kind == ExprKind::Ident) {
+        /// lookup key viewed the parser's text, keep the node's own copy
+        key.name = expr_cast<Ident>(*node).value();
+    }
+    nodes_.emplace(key, node);
+    return node;
+}
+
+Expr_t HashConsBuilder::number(double value)
+{
+    Key key{ ExprKind::Number, TOK_NUM, {}, 0, {} };
+    std::memcpy(&key.bits, &value, sizeof(value));
+    return intern(key, [&] { return inner_.number(value); });
+}
+
+Expr_t HashConsBuilder::ident(std::string_view name, SymbolId symbol)
+{
+    /// the same name from different symbol tables is a different node
+    Key key{ ExprKind::Ident, TOK_ID, {}, symbol.bits(), name };
+    return intern(key, [&] { return inner_.ident(name, symbol); });
+}
+
+Expr_t HashConsBuilder::unary(const Token& op, const Expr_t& operand)
+{
+    Key key{ ExprKind::Unary, op.token_type, { operand.get() }, 0, {} };
+    return intern(key, [&] { return inner_.unary(op, operand); });
+}
+
+Expr_t HashConsBuilder::postfix_unary(const Token& op, const Expr_t& operand)
+{
+    Key key{ ExprKind::PostfixUnary, op.token_type, { operand.get() }, 0, {} };
+    return intern(key, [&] { return inner_.postfix_unary(op, operand); });
+}
+
+Expr_t HashConsBuilder::binary(const Token& op, const Expr_t& left, const Expr_t& right)
+{
+    Key key{ ExprKind::Binary, op.token_type, { left.get(), right.get() }, 0, {} };
+    return intern(key, [&] { return inner_.binary(op, left, right); });
+}
+
+Expr_t HashConsBuilder::tenary(const Token& op, const Expr_t& operand1,
+    const Expr_t& operand2, const Expr_t& operand3)
+{
+    Key key{ ExprKind::Tenary, op.token_type, { operand1.get(), operand2.get(), operand3.get() }, 0, {} };
+    return intern(key, [&] { return inner_.tenary(op, operand1, operand2, operand3); });
+}
+}  // namespace pp_expr
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ast.h"
+#include "builder.h"
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+namespace pp_expr
+{
+/// interning node factory: a node is only built once for each operator,
+/// children identity and literal value, so structurally identical subtrees
+/// become one shared node and equal subexpressions compare equal by pointer.
+/// Parse many expressions with one builder to turn the forest into a DAG.
+/// Nodes are created by `inner` and stay alive as long as the builder.
+/// Not thread safe.
+class HashConsBuilder : public AstBuilder {
+public:
+    explicit HashConsBuilder(AstBuilder& inner = heap_builder()) : inner_(inner) {}
+
+    Expr_t number(double value) override;
+    Expr_t ident(std::string_view name, SymbolId symbol = {}) override;
+    Expr_t unary(const Token& op, const Expr_t& operand) override;
+    Expr_t postfix_unary(const Token& op, const Expr_t& operand) override;
+    Expr_t binary(const Token& op, const Expr_t& left, const Expr_t& right) override;
+    Expr_t tenary(const Token& op, const Expr_t& operand1,
+        const Expr_t& operand2, const Expr_t& operand3) override;
+
+    /// distinct nodes interned so far
+    size_t size() const { return nodes_.size(); }
+    /// requests answered by an existing node
+    size_t hits() const { return hits_; }
+    void clear() { nodes_.clear(); hits_ = 0; }
+private:
+    struct Key {
+        ExprKind kind;
+        TokenType op;
+        const Expr* children[3];
+        uint64_t bits;          // Number value bit pattern, Ident symbol
+        std::string_view name;  // Ident name, refers to the interned node
+
+        bool operator ==(const Key& other) const {
+            return kind == other.kind && op == other.op
+                && children[0] == other.children[0]
+                && children[1] == other.children[1]
+                && children[2] == other.children[2]
+                && bits == other.bits && name == other.name;
+        }
+    };
+    struct KeyHash {
+        size_t operator ()(const Key& key) const;
+    };
+
+    /// find node of `key`, or build it with `make` and intern it
+    template <typename Make>
+    Expr_t intern(Key key, Make make);
+
+    AstBuilder& inner_;
+    std::unordered_map<Key, Expr_t, KeyHash> nodes_;
+    size_t hits_{0};
+};
+}  // namespace pp_expr
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/// parse instrumentation is opt-in (cmake -DPP_EXPR_INSTRUMENT=ON); when it
+/// is off PP_EXPR_STAT expands to nothing and no counter is touched
+#ifndef PP_EXPR_INSTRUMENT
+#define PP_EXPR_INSTRUMENT 0
+#endif
+
+#if PP_EXPR_INSTRUMENT
+#define PP_EXPR_STAT(...) __VA_ARGS__
+#else
+#define PP_EXPR_STAT(...)
+#endif
+
+namespace pp_expr
+{
+/// allocations made by the library on this thread: heap nodes, arena blocks
+/// and parser stack growth; a parse reports the difference
+struct AllocStats {
+    size_t calls{0};
+    size_t bytes{0};
+};
+
+inline AllocStats& thread_alloc_stats()
+{
+    thread_local AllocStats stats;
+    return stats;
+}
+
+inline void note_alloc(size_t bytes)
+{
+    auto& stats = thread_alloc_stats();
+    stats.calls++;
+    stats.bytes += bytes;
+}
+
+/// std::allocator that records into thread_alloc_stats(), lets
+/// allocate_shared report the node and its control block as one allocation
+template <typename T>
+struct CountingAllocator : std::allocator<T> {
+    using value_type = T;
+    template <typename U>
+    struct rebind { using other = CountingAllocator<U>; };
+
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        note_alloc(n * sizeof(T));
+        return std::allocator<T>::allocate(n);
+    }
+};
+}  // namespace pp_expr
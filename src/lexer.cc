@@ -0,0 +1,136 @@
+#include "lexer.h"
+#include "parse_stats.h"
+
+namespace pp_expr
+{
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool is_ident_start(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool is_ident_char(char c)
+{
+    return is_ident_start(c) || is_digit(c);
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+/// length of the built-in operator spelled `c` `c2`..., 0 if none
+static size_t builtin_length(char c, char c2)
+{
+    switch (c) {
+    case '+': return c2 == '+' ? 2 : 1;
+    case '-': return c2 == '-' ? 2 : 1;
+    case '&': return c2 == '&' ? 2 : 1;
+    case '=': return c2 == '=' ? 2 : 1;
+    case '<':
+    case '>': return c2 == '=' ? 2 : 1;
+    case '!': return c2 == '=' ? 2 : 0;
+    case '|': return c2 == '|' ? 2 : 0;
+    case '*': case '/': case '?': case ':':
+    case '(': case ')': case '[': case ']': case ';':
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+bool Lexer::next(Token& token)
+{
+    const size_t size = source_.size();
+    while (curr_ < size && is_space(source_[curr_])) {
+        curr_++;
+    }
+    if (curr_ >= size) {
+        return false;
+    }
+
+    const size_t start = curr_;
+    auto peek = [&](size_t n) { return curr_ + n < size ? source_[curr_ + n] : '\0'; };
+    auto emit = [&](TokenType token_type, size_t len) {
+        curr_ = start + len;
+        token = Token{ token_type, source_.substr(start, len) };
+        return true;
+    };
+
+    const char c = source_[curr_];
+    /// number: 12, 1.5, .5, 1e-3
+    if (is_digit(c) || (c == '.' && is_digit(peek(1)))) {
+        size_t n = 0;
+        while (is_digit(peek(n))) n++;
+        if (peek(n) == '.') {
+            n++;
+            while (is_digit(peek(n))) n++;
+        }
+        if (peek(n) == 'e' || peek(n) == 'E') {
+            size_t m = n + 1;
+            if (peek(m) == '+' || peek(m) == '-') m++;
+            if (is_digit(peek(m))) {
+                while (is_digit(peek(m))) m++;
+                n = m;
+            }
+        }
+        return emit(TOK_NUM, n);
+    }
+    if (is_ident_start(c)) {
+        size_t n = 1;
+        while (is_ident_char(peek(n))) n++;
+        TokenType word;
+        if (ops_->has_user_operators() && ops_->match(source_.substr(start, n), word) == n) {
+            return emit(word, n);
+        }
+        return emit(TOK_ID, n);
+    }
+
+    if (ops_->has_user_operators()) {
+        TokenType user;
+        size_t n = ops_->match(source_.substr(start), user);
+        /// longest match wins, user spellings never equal built-in ones
+        if (n > 0 && n > builtin_length(c, peek(1))) {
+            return emit(user, n);
+        }
+    }
+
+    const char c2 = peek(1);
+    switch (c) {
+    case '+': return c2 == '+' ? emit(TOK_INC, 2) : emit(TOK_PLUS, 1);
+    case '-': return c2 == '-' ? emit(TOK_DEC, 2) : emit(TOK_MINUS, 1);
+    case '*': return emit(TOK_STAR, 1);
+    case '/': return emit(TOK_SLASH, 1);
+    case '&': return c2 == '&' ? emit(TOK_AND, 2) : emit(TOK_AMPERSAND, 1);
+    case '=': return c2 == '=' ? emit(TOK_EQ, 2) : emit(TOK_ASSIGN, 1);
+    case '!': return c2 == '=' ? emit(TOK_NE, 2) : emit(TOK_INVALID, 1);
+    case '<': return c2 == '=' ? emit(TOK_LE, 2) : emit(TOK_LT, 1);
+    case '>': return c2 == '=' ? emit(TOK_GE, 2) : emit(TOK_GT, 1);
+    case '|': return c2 == '|' ? emit(TOK_OR, 2) : emit(TOK_INVALID, 1);
+    case '?': return emit(TOK_QUESTION, 1);
+    case ':': return emit(TOK_COLON, 1);
+    case '(': return emit(TOK_LPAREN, 1);
+    case ')': return emit(TOK_RPAREN, 1);
+    case '[': return emit(TOK_LSQUAR, 1);
+    case ']': return emit(TOK_RSQUAR, 1);
+    case ';': return emit(TOK_SEMI, 1);
+    default:
+        return emit(TOK_INVALID, 1);
+    }
+}
+
+void tokenize(std::string_view source, std::vector<Token>& tokens, const OperatorTable& ops)
+{
+    PP_EXPR_STAT(uint64_t start = stats_clock_ns());
+    Lexer lexer(source, ops);
+    Token token;
+    while (lexer.next(token)) {
+        tokens.push_back(token);
+    }
+    PP_EXPR_STAT(add_thread_lex_ns(stats_clock_ns() - start));
+}
+}  // namespace pp_expr
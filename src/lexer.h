@@ -0,0 +1,43 @@
+#pragma once
+
+#include "operators.h"
+#include "tokens.h"
+
+#include <string_view>
+#include <vector>
+
+namespace pp_expr
+{
+/// scan source text into tokens without copying it, every token's lexeme is
+/// a view into the source buffer, which must outlive the tokens. User
+/// operators of `ops` are recognized too, the longest spelling wins
+class Lexer {
+public:
+    explicit Lexer(std::string_view source, const OperatorTable& ops = OperatorTable::builtin())
+        : source_(source), ops_(&ops) {}
+
+    /// scan next token into `token`, return false when input is exhausted;
+    /// a character that starts no token is returned as TOK_INVALID
+    bool next(Token& token);
+
+    /// offset of the next unscanned character
+    size_t offset() const { return curr_; }
+    std::string_view source() const { return source_; }
+private:
+    std::string_view source_;
+    const OperatorTable* ops_;
+    size_t curr_{0};
+};
+
+/// append all tokens of `source` to `tokens`, so the vector can be reused
+void tokenize(std::string_view source, std::vector<Token>& tokens,
+    const OperatorTable& ops = OperatorTable::builtin());
+
+inline std::vector<Token> tokenize(std::string_view source,
+    const OperatorTable& ops = OperatorTable::builtin())
+{
+    std::vector<Token> tokens;
+    tokenize(source, tokens, ops);
+    return tokens;
+}
+}  // namespace pp_expr
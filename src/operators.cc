@@ -0,0 +1,225 @@
+#include "operators.h"
+#include "precedence.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace pp_expr
+{
+namespace
+{
+/// user operator spellings of the process, append only: a spelling is
+/// published after it is stored, so readers need no lock
+struct UserSpellings {
+    std::mutex mutex;
+    std::deque<std::string> storage;
+    std::array<std::atomic<const char*>, kTokenTypeLimit> text{};
+};
+
+UserSpellings& user_spellings()
+{
+    static UserSpellings spellings;
+    return spellings;
+}
+
+bool is_word_start(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool is_word_char(char c)
+{
+    return is_word_start(c) || (c >= '0' && c <= '9');
+}
+
+/// characters a punctuation operator may use: not space, alphanumeric,
+/// quotes or the brackets and separators the parser relies on
+bool is_operator_char(char c)
+{
+    static constexpr std::string_view chars = "+-*/%&|^~!<>=?:.@#$\\";
+    return chars.find(c) != std::string_view::npos;
+}
+
+bool is_builtin_spelling(std::string_view spelling)
+{
+    for (int type = 0; type < TOK_NUM; type++) {
+        if (spelling == Lexeme(static_cast<TokenType>(type))) {
+            return true;
+        }
+    }
+    return false;
+}
+}  // namespace
+
+const char* user_operator_spelling(TokenType token_type)
+{
+    const char* text = user_spellings().text[token_type].load(std::memory_order_acquire);
+    return text ? text : "";
+}
+
+TokenType intern_operator(std::string_view spelling)
+{
+    auto& spellings = user_spellings();
+    std::lock_guard<std::mutex> lock(spellings.mutex);
+    for (size_t i = 0; i < spellings.storage.size(); i++) {
+        if (spellings.storage[i] == spelling) {
+            return static_cast<TokenType>(TOK_USER + i);
+        }
+    }
+    size_t type = TOK_USER + spellings.storage.size();
+    if (type >= kTokenTypeLimit) {
+        throw std::length_error("too many user operators");
+    }
+    spellings.storage.emplace_back(spelling);
+    spellings.text[type].store(spellings.storage.back().c_str(), std::memory_order_release);
+    return static_cast<TokenType>(type);
+}
+
+OperatorTable::OperatorTable()
+{
+    prefix_kinds_[TOK_ID]        = PREFIX_IDENT;
+    prefix_kinds_[TOK_NUM]       = PREFIX_NUM;
+    prefix_kinds_[TOK_INC]       = PREFIX_UNARY;
+    prefix_kinds_[TOK_DEC]       = PREFIX_UNARY;
+    prefix_kinds_[TOK_PLUS]      = PREFIX_UNARY;
+    prefix_kinds_[TOK_MINUS]     = PREFIX_UNARY;
+    prefix_kinds_[TOK_STAR]      = PREFIX_UNARY;
+    prefix_kinds_[TOK_AMPERSAND] = PREFIX_UNARY;
+    prefix_kinds_[TOK_LPAREN]    = PREFIX_PAREN;
+
+    infix_kinds_[TOK_ASSIGN]   = INFIX_BINARY_RIGHT;
+    infix_kinds_[TOK_QUESTION] = INFIX_QUESTION;
+    infix_kinds_[TOK_PLUS]     = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_MINUS]    = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_STAR]     = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_SLASH]    = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_EQ]       = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_NE]       = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_LT]       = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_LE]       = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_GT]       = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_GE]       = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_AND]      = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_OR]       = INFIX_BINARY_LEFT;
+    infix_kinds_[TOK_LSQUAR]   = INFIX_INDEX;
+    infix_kinds_[TOK_INC]      = INFIX_POSTFIX;
+    infix_kinds_[TOK_DEC]      = INFIX_POSTFIX;
+
+    std::copy(unary_op_precedences.begin(), unary_op_precedences.end(), prefix_precs_.begin());
+    std::copy(binary_op_precedences.begin(), binary_op_precedences.end(), infix_precs_.begin());
+}
+
+const OperatorTable& OperatorTable::builtin()
+{
+    static const OperatorTable table;
+    return table;
+}
+
+size_t OperatorTable::match(std::string_view text, TokenType& type) const
+{
+    if (text.empty()) {
+        return 0;
+    }
+    auto c = static_cast<unsigned char>(text[0]);
+    for (size_t i = first_[c]; i < first_[c + 1]; i++) {
+        const Spelling& spelling = spellings_[i];
+        if (text.compare(0, spelling.text.size(), spelling.text) != 0) {
+            continue;
+        }
+        if (spelling.word && text.size() > spelling.text.size()
+            && is_word_char(text[spelling.text.size()])) {
+            continue;
+        }
+        type = spelling.type;
+        return spelling.text.size();
+    }
+    return 0;
+}
+
+OperatorRegistry::OperatorRegistry()
+    : table_(OperatorTable::builtin())
+{}
+
+TokenType OperatorRegistry::add(std::string_view spelling, int precedence)
+{
+    bool word = !spelling.empty() && is_word_start(spelling[0])
+        && std::all_of(spelling.begin(), spelling.end(), is_word_char);
+    bool punct = !spelling.empty() && std::all_of(spelling.begin(), spelling.end(), is_operator_char);
+    if (!word && !punct) {
+        throw std::invalid_argument("invalid operator spelling '" + std::string(spelling) + "'");
+    }
+    if (is_builtin_spelling(spelling)) {
+        throw std::invalid_argument("'" + std::string(spelling) + "' is a built-in operator");
+    }
+    if (precedence <= 0) {
+        throw std::invalid_argument("operator precedence must be positive");
+    }
+    TokenType type = intern_operator(spelling);
+    auto& spellings = table_.spellings_;
+    bool known = std::any_of(spellings.begin(), spellings.end(),
+        [type](const OperatorTable::Spelling& s) { return s.type == type; });
+    if (!known) {
+        spellings.push_back({ Lexeme(type), type, word });
+    }
+    return type;
+}
+
+TokenType OperatorRegistry::add_prefix(std::string_view spelling, int precedence)
+{
+    TokenType type = add(spelling, precedence);
+    if (table_.prefix_kinds_[type] != PREFIX_NONE) {
+        throw std::invalid_argument("prefix operator '" + std::string(spelling) + "' defined twice");
+    }
+    table_.prefix_kinds_[type] = PREFIX_UNARY;
+    table_.prefix_precs_[type] = precedence;
+    return type;
+}
+
+TokenType OperatorRegistry::add_infix(std::string_view spelling, int precedence, Assoc assoc)
+{
+    TokenType type = add(spelling, precedence);
+    if (table_.infix_kinds_[type] != INFIX_NONE) {
+        throw std::invalid_argument("infix or postfix operator '" + std::string(spelling) + "' defined twice");
+    }
+    table_.infix_kinds_[type] = assoc == Assoc::Left ? INFIX_BINARY_LEFT : INFIX_BINARY_RIGHT;
+    table_.infix_precs_[type] = precedence;
+    return type;
+}
+
+TokenType OperatorRegistry::add_postfix(std::string_view spelling, int precedence)
+{
+    TokenType type = add(spelling, precedence);
+    if (table_.infix_kinds_[type] != INFIX_NONE) {
+        throw std::invalid_argument("infix or postfix operator '" + std::string(spelling) + "' defined twice");
+    }
+    table_.infix_kinds_[type] = INFIX_POSTFIX;
+    table_.infix_precs_[type] = precedence;
+    return type;
+}
+
+std::shared_ptr<const OperatorTable> OperatorRegistry::freeze() const
+{
+    auto table = std::shared_ptr<OperatorTable>(new OperatorTable(table_));
+    auto& spellings = table->spellings_;
+    std::sort(spellings.begin(), spellings.end(),
+        [](const OperatorTable::Spelling& a, const OperatorTable::Spelling& b) {
+            if (a.text[0] != b.text[0]) {
+                return static_cast<unsigned char>(a.text[0]) < static_cast<unsigned char>(b.text[0]);
+            }
+            return a.text.size() > b.text.size();
+        });
+    size_t i = 0;
+    for (size_t c = 0; c < 256; c++) {
+        table->first_[c] = static_cast<uint16_t>(i);
+        while (i < spellings.size() && static_cast<unsigned char>(spellings[i].text[0]) == c) {
+            i++;
+        }
+    }
+    table->first_[256] = static_cast<uint16_t>(i);
+    return table;
+}
+}  // namespace pp_expr
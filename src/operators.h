@@ -0,0 +1,101 @@
+#pragma once
+
+#include "tokens.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace pp_expr
+{
+/// how a token starts an operand
+enum PrefixKind : uint8_t {
+    PREFIX_NONE,
+    PREFIX_IDENT,
+    PREFIX_NUM,
+    PREFIX_UNARY,
+    PREFIX_PAREN,
+};
+
+/// how a token continues an operand on its left
+enum InfixKind : uint8_t {
+    INFIX_NONE,
+    INFIX_BINARY_LEFT,
+    INFIX_BINARY_RIGHT,
+    INFIX_QUESTION,
+    INFIX_INDEX,
+    INFIX_POSTFIX,
+};
+
+enum class Assoc : uint8_t {
+    Left,
+    Right,
+};
+
+/// the operators a Lexer and Parser understand: dense tables indexed by
+/// token type, plus the spellings of user operators for the lexer. Immutable
+/// once built, so one table can serve any number of threads
+class OperatorTable {
+public:
+    /// the operators of tokens.h, used when no table is given
+    static const OperatorTable& builtin();
+
+    PrefixKind prefix_kind(TokenType type) const { return prefix_kinds_[type]; }
+    InfixKind infix_kind(TokenType type) const { return infix_kinds_[type]; }
+    /// binding power, see precedence.h; 0 if the token has no such role
+    int prefix_precedence(TokenType type) const { return prefix_precs_[type]; }
+    int infix_precedence(TokenType type) const { return infix_precs_[type]; }
+
+    bool has_user_operators() const { return !spellings_.empty(); }
+    /// longest user operator spelled at the start of `text`, a word operator
+    /// only if no identifier character follows it; returns its length and
+    /// sets `type`, or 0
+    size_t match(std::string_view text, TokenType& type) const;
+private:
+    friend class OperatorRegistry;
+    OperatorTable();
+
+    struct Spelling {
+        std::string_view text;  ///< interned, see Lexeme()
+        TokenType type;
+        bool word;
+    };
+
+    std::array<PrefixKind, kTokenTypeLimit> prefix_kinds_{};
+    std::array<InfixKind, kTokenTypeLimit> infix_kinds_{};
+    std::array<int, kTokenTypeLimit> prefix_precs_{};
+    std::array<int, kTokenTypeLimit> infix_precs_{};
+    /// grouped by first character, longest first within a group;
+    /// spellings_[first_[c] .. first_[c + 1]) start with c
+    std::vector<Spelling> spellings_;
+    std::array<uint16_t, 257> first_{};
+};
+
+/// collects user defined operators at startup, then freeze() makes the
+/// table lexers and parsers read. Each spelling has one token type for the
+/// whole process, its roles and precedences are per table. Spellings are
+/// either punctuation (`**`, `<<`, `%`) or a word (`in`); they can't reuse
+/// a built-in operator. Invalid or conflicting definitions throw
+/// std::invalid_argument.
+class OperatorRegistry {
+public:
+    /// starts from the built-in operators
+    OperatorRegistry();
+
+    TokenType add_prefix(std::string_view spelling, int precedence);
+    TokenType add_infix(std::string_view spelling, int precedence, Assoc assoc = Assoc::Left);
+    TokenType add_postfix(std::string_view spelling, int precedence);
+
+    std::shared_ptr<const OperatorTable> freeze() const;
+private:
+    TokenType add(std::string_view spelling, int precedence);
+
+    OperatorTable table_;
+};
+
+/// token type of a user operator spelling, assigned on first use and kept
+/// for the life of the process; throws std::length_error past kTokenTypeLimit
+TokenType intern_operator(std::string_view spelling);
+}  // namespace pp_expr
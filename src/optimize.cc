@@ -0,0 +1,330 @@
+#include "optimize.h"
+#include "eval.h"
+#include "visitor.h"
+
+#include <vector>
+
+namespace pp_expr
+{
+namespace
+{
+/// works with an explicit stack of steps and a stack of optimized
+/// subtrees, so trees deeper than the call stack (a long `a + a + ...`
+/// chain the parser accepts) are fine
+class Optimizer {
+public:
+    explicit Optimizer(AstBuilder& builder) : builder_(builder) {}
+
+    Expr_t optimize(const Expr_t& expr);
+private:
+    enum Step : uint8_t {
+        STEP_VISIT,
+        /// operand of `=` `++` `--`: only its index may change
+        STEP_VISIT_LVALUE,
+        /// the rest pop the results of the steps they scheduled
+        STEP_UNARY,
+        STEP_UNARY_LVALUE,
+        STEP_POSTFIX,
+        STEP_ASSIGN,
+        STEP_INDEX,
+        STEP_LOGIC_LEFT,    ///< && || after their left operand
+        STEP_TRUTH,
+        STEP_BINARY,
+        STEP_TENARY_COND,   ///< after the condition
+        STEP_TENARY,
+    };
+
+    struct Task {
+        Step step;
+        const Expr_t* expr;
+    };
+
+    void schedule(Step step, const Expr_t& expr) { tasks_.push_back(Task{ step, &expr }); }
+    Expr_t pop_result() {
+        Expr_t result = std::move(results_.back());
+        results_.pop_back();
+        return result;
+    }
+
+    void visit(const Expr_t& expr);
+    void visit_lvalue(const Expr_t& expr);
+    Expr_t unary(const Expr_t& expr, Expr_t operand);
+    void logic_left(const Expr_t& expr);
+    Expr_t binary(const Expr_t& expr, Expr_t left, Expr_t right);
+    void tenary_cond(const Expr_t& expr);
+    /// `x != 0`, the value && and || give for their deciding operand
+    Expr_t truth(const Expr_t& expr);
+
+    AstBuilder& builder_;
+    std::vector<Task> tasks_;
+    std::vector<Expr_t> results_;
+};
+
+bool is_number(const Expr_t& expr)
+{
+    return expr->kind() == ExprKind::Number;
+}
+
+double number(const Expr_t& expr)
+{
+    return expr_cast<Number>(*expr).value();
+}
+
+bool is_number(const Expr_t& expr, double value)
+{
+    return is_number(expr) && number(expr) == value;
+}
+
+/// built-in arithmetic and comparison, user operators have no value here
+bool is_foldable(TokenType op)
+{
+    switch (op) {
+    case TOK_PLUS: case TOK_MINUS: case TOK_STAR: case TOK_SLASH:
+    case TOK_EQ: case TOK_NE: case TOK_LT: case TOK_LE: case TOK_GT: case TOK_GE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+Expr_t Optimizer::optimize(const Expr_t& root)
+{
+    schedule(STEP_VISIT, root);
+    while (!tasks_.empty()) {
+        Task task = tasks_.back();
+        tasks_.pop_back();
+        const Expr_t& expr = *task.expr;
+        switch (task.step) {
+        case STEP_VISIT:
+            visit(expr);
+            break;
+        case STEP_VISIT_LVALUE:
+            visit_lvalue(expr);
+            break;
+        case STEP_UNARY: {
+            auto operand = pop_result();
+            results_.push_back(unary(expr, std::move(operand)));
+            break;
+        }
+        case STEP_UNARY_LVALUE: {
+            auto& unary = expr_cast<UnaryExpr>(*expr);
+            auto operand = pop_result();
+            results_.push_back(operand == unary.operand() ? expr : builder_.unary(unary.op(), operand));
+            break;
+        }
+        case STEP_POSTFIX: {
+            auto& postfix = expr_cast<PostfixUnaryExpr>(*expr);
+            auto operand = pop_result();
+            results_.push_back(operand == postfix.operand() ? expr : builder_.postfix_unary(postfix.op(), operand));
+            break;
+        }
+        case STEP_ASSIGN: {
+            auto& assign = expr_cast<BinaryExpr>(*expr);
+            auto right = pop_result();
+            auto left = pop_result();
+            results_.push_back(left == assign.left() && right == assign.right()
+                ? expr : builder_.binary(assign.op(), left, right));
+            break;
+        }
+        case STEP_INDEX: {
+            auto& index = expr_cast<BinaryExpr>(*expr);
+            auto right = pop_result();
+            results_.push_back(right == index.right() ? expr : builder_.binary(index.op(), index.left(), right));
+            break;
+        }
+        case STEP_LOGIC_LEFT:
+            logic_left(expr);
+            break;
+        case STEP_TRUTH: {
+            auto operand = pop_result();
+            results_.push_back(truth(operand));
+            break;
+        }
+        case STEP_BINARY: {
+            auto right = pop_result();
+            auto left = pop_result();
+            results_.push_back(binary(expr, std::move(left), std::move(right)));
+            break;
+        }
+        case STEP_TENARY_COND:
+            tenary_cond(expr);
+            break;
+        case STEP_TENARY: {
+            auto& tenary = expr_cast<TenaryExpr>(*expr);
+            auto on_false = pop_result();
+            auto on_true = pop_result();
+            auto cond = pop_result();
+            results_.push_back(cond == tenary.operand1() && on_true == tenary.operand2()
+                    && on_false == tenary.operand3()
+                ? expr : builder_.tenary(tenary.op(), cond, on_true, on_false));
+            break;
+        }
+        }
+    }
+    return pop_result();
+}
+
+/// steps run last pushed first, so operands are scheduled right to left
+void Optimizer::visit(const Expr_t& expr)
+{
+    switch (expr->kind()) {
+    case ExprKind::Number:
+    case ExprKind::Ident:
+        results_.push_back(expr);
+        break;
+    case ExprKind::Unary: {
+        auto& unary = expr_cast<UnaryExpr>(*expr);
+        auto op = unary.op().token_type;
+        if (op == TOK_INC || op == TOK_DEC) {
+            schedule(STEP_UNARY_LVALUE, expr);
+            schedule(STEP_VISIT_LVALUE, unary.operand());
+        } else {
+            schedule(STEP_UNARY, expr);
+            schedule(STEP_VISIT, unary.operand());
+        }
+        break;
+    }
+    case ExprKind::PostfixUnary:
+        schedule(STEP_POSTFIX, expr);
+        schedule(STEP_VISIT_LVALUE, expr_cast<PostfixUnaryExpr>(*expr).operand());
+        break;
+    case ExprKind::Binary: {
+        auto& binary = expr_cast<BinaryExpr>(*expr);
+        switch (binary.op().token_type) {
+        case TOK_ASSIGN:
+            schedule(STEP_ASSIGN, expr);
+            schedule(STEP_VISIT, binary.right());
+            schedule(STEP_VISIT_LVALUE, binary.left());
+            break;
+        case TOK_LSQUAR:
+            visit_lvalue(expr);
+            break;
+        case TOK_AND:
+        case TOK_OR:
+            schedule(STEP_LOGIC_LEFT, expr);
+            schedule(STEP_VISIT, binary.left());
+            break;
+        default:
+            schedule(STEP_BINARY, expr);
+            schedule(STEP_VISIT, binary.right());
+            schedule(STEP_VISIT, binary.left());
+            break;
+        }
+        break;
+    }
+    case ExprKind::Tenary:
+        schedule(STEP_TENARY_COND, expr);
+        schedule(STEP_VISIT, expr_cast<TenaryExpr>(*expr).operand1());
+        break;
+    }
+}
+
+void Optimizer::visit_lvalue(const Expr_t& expr)
+{
+    if (expr->kind() == ExprKind::Binary) {
+        auto& index = expr_cast<BinaryExpr>(*expr);
+        if (index.op().token_type == TOK_LSQUAR) {
+            schedule(STEP_INDEX, expr);
+            schedule(STEP_VISIT, index.right());
+            return;
+        }
+    }
+    results_.push_back(expr);
+}
+
+Expr_t Optimizer::unary(const Expr_t& expr, Expr_t operand)
+{
+    auto& unary = expr_cast<UnaryExpr>(*expr);
+    auto op = unary.op().token_type;
+    if (op == TOK_PLUS) {
+        return operand;
+    }
+    if (op == TOK_MINUS) {
+        if (is_number(operand)) {
+            return builder_.number(-number(operand));
+        }
+        if (operand->kind() == ExprKind::Unary
+            && expr_cast<UnaryExpr>(*operand).op().token_type == TOK_MINUS) {
+            return expr_cast<UnaryExpr>(*operand).operand();
+        }
+    }
+    return operand == unary.operand() ? expr : builder_.unary(unary.op(), operand);
+}
+
+Expr_t Optimizer::truth(const Expr_t& expr)
+{
+    if (is_number(expr)) {
+        return builder_.number(number(expr) != 0);
+    }
+    return builder_.binary(Token{ TOK_NE, Lexeme(TOK_NE) }, expr, builder_.number(0));
+}
+
+void Optimizer::logic_left(const Expr_t& expr)
+{
+    auto& binary = expr_cast<BinaryExpr>(*expr);
+    auto op = binary.op().token_type;
+    if (!is_number(results_.back())) {
+        schedule(STEP_BINARY, expr);
+        schedule(STEP_VISIT, binary.right());
+        return;
+    }
+    /// constant left operand decides, or leaves only the right one
+    bool truth_left = number(pop_result()) != 0;
+    if (op == TOK_AND ? !truth_left : truth_left) {
+        results_.push_back(builder_.number(truth_left));
+        return;
+    }
+    schedule(STEP_TRUTH, expr);
+    schedule(STEP_VISIT, binary.right());
+}
+
+Expr_t Optimizer::binary(const Expr_t& expr, Expr_t left, Expr_t right)
+{
+    auto& binary = expr_cast<BinaryExpr>(*expr);
+    auto op = binary.op().token_type;
+    if (is_number(left) && is_number(right) && is_foldable(op)) {
+        return builder_.number(apply_binary(op, number(left), number(right)));
+    }
+    switch (op) {
+    case TOK_PLUS:
+        if (is_number(right, 0)) return left;
+        if (is_number(left, 0)) return right;
+        break;
+    case TOK_MINUS:
+        if (is_number(right, 0)) return left;
+        break;
+    case TOK_STAR:
+        if (is_number(right, 1)) return left;
+        if (is_number(left, 1)) return right;
+        break;
+    case TOK_SLASH:
+        if (is_number(right, 1)) return left;
+        break;
+    default:
+        break;
+    }
+    if (left == binary.left() && right == binary.right()) {
+        return expr;
+    }
+    return builder_.binary(binary.op(), left, right);
+}
+
+void Optimizer::tenary_cond(const Expr_t& expr)
+{
+    auto& tenary = expr_cast<TenaryExpr>(*expr);
+    if (is_number(results_.back())) {
+        bool cond = number(pop_result()) != 0;
+        schedule(STEP_VISIT, cond ? tenary.operand2() : tenary.operand3());
+        return;
+    }
+    schedule(STEP_TENARY, expr);
+    schedule(STEP_VISIT, tenary.operand3());
+    schedule(STEP_VISIT, tenary.operand2());
+}
+}  // namespace
+
+Expr_t optimize(const Expr_t& expr, AstBuilder& builder)
+{
+    return Optimizer(builder).optimize(expr);
+}
+}  // namespace pp_expr
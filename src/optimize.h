@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ast.h"
+#include "builder.h"
+
+namespace pp_expr
+{
+/// fold literal-only subtrees into Number and apply simplifications that
+/// keep evaluate() results and side effects:
+///   -(-x) => x, +x => x, x * 1, 1 * x, x / 1, x - 0, x + 0, 0 + x => x,
+///   c ? a : b with constant c => a or b,
+///   0 && x => 0, 1 && x => x != 0, 1 || x => 1, 0 || x => x != 0
+/// (x + 0 may turn a -0 result into 0, which compares equal.)
+/// Operands of `=` `++` `--` keep their shape, so assignability doesn't
+/// change. Unchanged subtrees are shared with the input, new nodes are made
+/// by `builder`.
+Expr_t optimize(const Expr_t& expr, AstBuilder& builder = heap_builder());
+}  // namespace pp_expr
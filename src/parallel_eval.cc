@@ -0,0 +1,72 @@
+#include "parallel_eval.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace pp_expr
+{
+/// column pointers resolved once, tasks only read them
+static std::vector<const double*> resolve_inputs(const BatchProgram& program, const Columns& columns)
+{
+    std::vector<const double*> inputs;
+    for (auto& name : program.columns()) {
+        auto* data = columns.find(name);
+        if (!data) {
+            throw EvalError("unbound column '" + name + "'");
+        }
+        inputs.push_back(data);
+    }
+    return inputs;
+}
+
+static size_t chunk_count(size_t rows, size_t chunk_rows)
+{
+    return (rows + chunk_rows - 1) / chunk_rows;
+}
+
+void evaluate_parallel(const BatchProgram& program, const Columns& columns,
+    size_t rows, double* out, ThreadPool& pool, size_t chunk_rows)
+{
+    auto inputs = resolve_inputs(program, columns);
+    pool.parallel_for(chunk_count(rows, chunk_rows), [&](size_t chunk) {
+        size_t begin = chunk * chunk_rows;
+        program.run(inputs.data(), begin, std::min(rows, begin + chunk_rows), out);
+    });
+}
+
+double reduce_parallel(const BatchProgram& program, const Columns& columns,
+    size_t rows, Reduction reduction, ThreadPool& pool, size_t chunk_rows)
+{
+    auto inputs = resolve_inputs(program, columns);
+    std::vector<double> partials(chunk_count(rows, chunk_rows));
+    pool.parallel_for(partials.size(), [&](size_t chunk) {
+        thread_local std::vector<double> results;
+        thread_local std::vector<const double*> chunk_inputs;
+        size_t begin = chunk * chunk_rows;
+        size_t end = std::min(rows, begin + chunk_rows);
+        /// view the chunk as rows [0, end - begin) so results start at 0
+        chunk_inputs.resize(inputs.size());
+        for (size_t i = 0; i < inputs.size(); i++) {
+            chunk_inputs[i] = inputs[i] + begin;
+        }
+        results.resize(end - begin);
+        program.run(chunk_inputs.data(), 0, end - begin, results.data());
+        double partial = 0;
+        if (reduction == Reduction::Count) {
+            partial = static_cast<double>(std::count_if(results.begin(), results.end(),
+                [](double v) { return v != 0; }));
+        } else {
+            for (double v : results) {
+                partial += v;
+            }
+        }
+        partials[chunk] = partial;
+    });
+
+    double total = 0;
+    for (double partial : partials) {
+        total += partial;
+    }
+    return total;
+}
+}  // namespace pp_expr
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "batch_eval.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+
+namespace pp_expr
+{
+/// rows per parallel task: large enough to amortize scheduling, small enough
+/// that the task's slice of every input column stays in L2
+static const size_t kParallelChunkRows = 16384;
+
+/// evaluate `program` over rows [0, rows) into `out` on `pool`, every task
+/// owns a disjoint row range and output slice
+void evaluate_parallel(const BatchProgram& program, const Columns& columns,
+    size_t rows, double* out, ThreadPool& pool, size_t chunk_rows = kParallelChunkRows);
+
+enum class Reduction {
+    Count,  // rows whose result is non zero
+    Sum,    // sum of results
+};
+
+/// reduce results over rows [0, rows) without materializing them; partials
+/// are per chunk and combined in chunk order, so the result is identical for
+/// any pool size or schedule with the same `chunk_rows`
+double reduce_parallel(const BatchProgram& program, const Columns& columns,
+    size_t rows, Reduction reduction, ThreadPool& pool, size_t chunk_rows = kParallelChunkRows);
+}  // namespace pp_expr
@@ -0,0 +1,81 @@
+#include "parse_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace pp_expr
+{
+static_assert(static_cast<size_t>(ExprKind::Tenary) + 1 == kExprKindCount,
+    "ParseStats::nodes needs a counter per ExprKind");
+
+static std::atomic<ParseStatsSink*> g_default_sink{nullptr};
+static thread_local uint64_t t_lex_ns = 0;
+
+size_t ParseStats::node_count() const
+{
+    size_t count = 0;
+    for (auto n : nodes) {
+        count += n;
+    }
+    return count;
+}
+
+ParseStats& ParseStats::operator +=(const ParseStats& other)
+{
+    tokens += other.tokens;
+    for (size_t i = 0; i < kExprKindCount; i++) {
+        nodes[i] += other.nodes[i];
+    }
+    max_depth = std::max(max_depth, other.max_depth);
+    allocs += other.allocs;
+    alloc_bytes += other.alloc_bytes;
+    lex_ns += other.lex_ns;
+    parse_ns += other.parse_ns;
+    failed = failed || other.failed;
+    return *this;
+}
+
+std::ostream& operator <<(std::ostream& os, const ParseStats& stats)
+{
+    static const char* const names[kExprKindCount] = {
+        "number", "ident", "unary", "postfix", "binary", "tenary",
+    };
+    os << "tokens=" << stats.tokens << " nodes=" << stats.node_count() << " (";
+    for (size_t i = 0; i < kExprKindCount; i++) {
+        os << (i ? " " : "") << names[i] << "=" << stats.nodes[i];
+    }
+    return os << ") depth=" << stats.max_depth
+              << " allocs=" << stats.allocs << " bytes=" << stats.alloc_bytes
+              << " lex_ns=" << stats.lex_ns << " parse_ns=" << stats.parse_ns
+              << (stats.failed ? " failed" : "");
+}
+
+void set_default_stats_sink(ParseStatsSink* sink)
+{
+    g_default_sink.store(sink, std::memory_order_release);
+}
+
+ParseStatsSink* default_stats_sink()
+{
+    return g_default_sink.load(std::memory_order_acquire);
+}
+
+uint64_t take_thread_lex_ns()
+{
+    uint64_t ns = t_lex_ns;
+    t_lex_ns = 0;
+    return ns;
+}
+
+void add_thread_lex_ns(uint64_t ns)
+{
+    t_lex_ns += ns;
+}
+
+uint64_t stats_clock_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}  // namespace pp_expr
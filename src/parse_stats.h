@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ast.h"
+#include "instrument.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace pp_expr
+{
+/// number of ExprKind values, for per kind counters
+static const size_t kExprKindCount = 6;
+
+/// what one parsed expression cost, only filled in instrumented builds
+struct ParseStats {
+    size_t tokens{0};                  ///< tokens consumed
+    size_t nodes[kExprKindCount]{};    ///< nodes built, indexed by ExprKind
+    size_t max_depth{0};               ///< deepest operator stack reached
+    size_t allocs{0};                  ///< allocations, see AllocStats
+    size_t alloc_bytes{0};
+    uint64_t lex_ns{0};                ///< tokenize() run on this thread before the parse
+    uint64_t parse_ns{0};
+    bool failed{false};
+
+    size_t node_count() const;
+    /// sums counters and times, keeps the larger max_depth
+    ParseStats& operator +=(const ParseStats& other);
+};
+
+/// one line: tokens=.. nodes=.. (per kind) depth=.. allocs=.. bytes=.. lex_ns=.. parse_ns=..
+std::ostream& operator <<(std::ostream& os, const ParseStats& stats);
+
+/// receives the stats of every expression a parser finishes, failed or not;
+/// called on the parsing thread
+class ParseStatsSink {
+public:
+    virtual ~ParseStatsSink() = default;
+    virtual void on_parse(const ParseStats& stats) = 0;
+};
+
+/// sink for parsers that have none of their own, e.g. inside ExprCache or
+/// parse_batch; null (the default) turns reporting off
+void set_default_stats_sink(ParseStatsSink* sink);
+ParseStatsSink* default_stats_sink();
+
+/// lex time accumulated on this thread since the last parse took it
+uint64_t take_thread_lex_ns();
+void add_thread_lex_ns(uint64_t ns);
+
+uint64_t stats_clock_ns();
+}  // namespace pp_expr
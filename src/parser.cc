@@ -1,165 +1,297 @@
 #include "parser.h"
-#include "precedence.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <charconv>
 
 namespace pp_expr
 {
-typedef Expr_t (*PrefixParser_t)(Parser& parser, const Token&);
-typedef Expr_t (*InfixParser_t)(Parser& parser, const Token&, const Expr_t& left);
-
-static Expr_t parse_unary_expr(Parser& parser, const Token& op_token)
+static double parse_number(const Token& token)
 {
-    return MakeExpr<UnaryExpr>(
-        op_token,
-        /// right associative,
-        /// -1 to make following prefix op have higher precedence,
-        /// and bind to the operand
-        parser.parse_expr(unary_op_precedences[op_token.token_type] - 1)
-    );
+    double value = 0;
+    auto text = token.lexeme();
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
 }
 
-static Expr_t parse_ident(Parser& parser, const Token& token)
+static ParseError unexpected(TokenType token_type)
 {
-    return MakeExpr<Ident>(token.lexeme);
+    return token_type == TOK_INVALID ? ParseError::InvalidToken : ParseError::UnexpectedToken;
 }
 
-static Expr_t parse_num(Parser& parser, const Token& token)
+Parser::Parser(const std::vector<Token>& tokens, AstBuilder& builder)
+    : Parser(tokens.data(), tokens.size(), builder)
+{}
+
+Parser::Parser(const Token* tokens, size_t count, AstBuilder& builder)
+    : tokens_(tokens), count_(count), builder_(&builder), ops_(&OperatorTable::builtin())
+{}
+
+Expr_t Parser::parse()
 {
-    return MakeExpr<Number>(strtod(token.lexeme.c_str(), nullptr));
+    return try_parse().ast;
 }
 
-static Expr_t parse_lparen_expr(Parser& parser, const Token& op_token)
+ParseResult Parser::try_parse()
 {
-    auto expr = parser.parse_expr(0);
-    parser.consume(TOK_RPAREN);
-    return expr;
+    if (endof_token()) {
+        error_ = Diagnostic{};
+        return ParseResult{};
+    }
+    return parse_one(true);
 }
 
-static std::map<TokenType, PrefixParser_t> PrefixParsers =
+std::vector<ParseResult> Parser::parse_all()
 {
-    { TOK_ID,        &parse_ident       },
-    { TOK_NUM,       &parse_num         },
-    { TOK_INC,       &parse_unary_expr  },
-    { TOK_DEC,       &parse_unary_expr  },
-    { TOK_PLUS,      &parse_unary_expr  },
-    { TOK_MINUS,     &parse_unary_expr  },
-    { TOK_STAR,      &parse_unary_expr  },
-    { TOK_AMPERSAND, &parse_unary_expr  },
-    { TOK_LPAREN,    &parse_lparen_expr },
-};
+    std::vector<ParseResult> results;
+    for (;;) {
+        while (match(TOK_SEMI)) {}
+        if (endof_token()) {
+            break;
+        }
+        results.push_back(parse_one(false));
+        if (!results.back().ok()) {
+            /// resync at the next expression boundary
+            while (!endof_token() && tokens_[curr_].token_type != TOK_SEMI) {
+                curr_++;
+            }
+        }
+    }
+    return results;
+}
 
-/// parse binary op expression for op with left associative
-static Expr_t parse_binary_expr_left(Parser& parser, const Token& op_token, const Expr_t& left)
+ParseResult Parser::parse_one(bool whole_input)
 {
-    return MakeExpr<BinaryExpr>(
-        op_token,
-        left,
-        parser.parse_expr(get_precedence(op_token.token_type))
-    );
+    error_ = Diagnostic{};
+    PP_EXPR_STAT(begin_stats());
+    auto ast = parse_expr();
+    if (!failed() && !endof_token() && (whole_input || tokens_[curr_].token_type != TOK_SEMI)) {
+        fail(frames_.size(), unexpected(tokens_[curr_].token_type), curr_);
+    }
+    PP_EXPR_STAT(end_stats());
+    if (failed()) {
+        return ParseResult{ nullptr, error_ };
+    }
+    return ParseResult{ std::move(ast), Diagnostic{} };
 }
 
-/// parse binary op expression for op with right associative
-static Expr_t parse_binary_expr_right(Parser& parser, const Token& op_token, const Expr_t& left)
+/// Pratt loop with the recursion turned inside out: where the recursive
+/// form would call parse_expr(p) for an operand, the operator is pushed as
+/// a frame and `prec` becomes p; once an operand can't be extended any
+/// further, the top frame is reduced with it and its own `prec` restored.
+Expr_t Parser::parse_expr(int prec)
 {
-    return MakeExpr<BinaryExpr>(
-        op_token,
-        left,
-        /// right associative for assignment: a = b = c => a = (b = c)
-        /// -1 to make following prefix op have higher precedence,
-        /// and bind to the operand
-        parser.parse_expr(get_precedence(op_token.token_type) - 1)
-    );
+    size_t base = frames_.size();
+    Expr_t left;
+    bool need_operand = true;
+    for (;;) {
+        if (need_operand) {
+            if (endof_token()) {
+                return fail(base, ParseError::UnexpectedEnd, curr_);
+            }
+            /// the offending token is left in place, so resync can see it
+            auto prefix = ops_->prefix_kind(tokens_[curr_].token_type);
+            if (prefix == PREFIX_NONE) {
+                return fail(base, unexpected(tokens_[curr_].token_type), curr_);
+            }
+            const Token& tok = advance();
+            switch (prefix) {
+            case PREFIX_IDENT:
+                left = builder_->ident(tok.lexeme());
+                PP_EXPR_STAT(stats_.nodes[static_cast<size_t>(ExprKind::Ident)]++);
+                break;
+            case PREFIX_NUM:
+                left = builder_->number(parse_number(tok));
+                PP_EXPR_STAT(stats_.nodes[static_cast<size_t>(ExprKind::Number)]++);
+                break;
+            case PREFIX_UNARY:
+                /// right associative,
+                /// -1 to make following prefix op have higher precedence,
+                /// and bind to the operand
+                if (!push_frame(FRAME_UNARY, prec, tok)) {
+                    return fail(base, ParseError::TooDeep, curr_ - 1);
+                }
+                prec = ops_->prefix_precedence(tok.token_type) - 1;
+                continue;
+            case PREFIX_PAREN:
+                if (!push_frame(FRAME_PAREN, prec, tok)) {
+                    return fail(base, ParseError::TooDeep, curr_ - 1);
+                }
+                prec = 0;
+                continue;
+            default:
+                break;
+            }
+            need_operand = false;
+        }
+
+        while (!endof_token() && cur_op_precedence() > prec) {
+            auto kind = ops_->infix_kind(tokens_[curr_].token_type);
+            if (kind == INFIX_NONE) {
+                break;
+            }
+            const Token& tok = advance();
+            int op_prec = ops_->infix_precedence(tok.token_type);
+            if (kind == INFIX_POSTFIX) {
+                left = builder_->postfix_unary(tok, left);
+                PP_EXPR_STAT(stats_.nodes[static_cast<size_t>(ExprKind::PostfixUnary)]++);
+                continue;
+            }
+            bool pushed = false;
+            switch (kind) {
+            case INFIX_BINARY_LEFT:
+                pushed = push_frame(FRAME_BINARY, prec, tok, std::move(left));
+                prec = op_prec;
+                break;
+            case INFIX_BINARY_RIGHT:
+                /// right associative for assignment: a = b = c => a = (b = c)
+                pushed = push_frame(FRAME_BINARY, prec, tok, std::move(left));
+                prec = op_prec - 1;
+                break;
+            case INFIX_QUESTION:
+                pushed = push_frame(FRAME_QUESTION, prec, tok, std::move(left));
+                prec = 0;
+                break;
+            default:
+                pushed = push_frame(FRAME_INDEX, prec, tok, std::move(left));
+                prec = 0;
+                break;
+            }
+            if (!pushed) {
+                return fail(base, ParseError::TooDeep, curr_ - 1);
+            }
+            need_operand = true;
+            break;
+        }
+        if (need_operand) {
+            continue;
+        }
+
+        if (frames_.size() == base) {
+            return left;
+        }
+        Frame frame = std::move(frames_.back());
+        frames_.pop_back();
+        prec = frame.prec;
+        switch (frame.kind) {
+        case FRAME_UNARY:
+            left = builder_->unary(frame.op, left);
+            PP_EXPR_STAT(stats_.nodes[static_cast<size_t>(ExprKind::Unary)]++);
+            break;
+        case FRAME_PAREN:
+            if (!consume(TOK_RPAREN)) {
+                frames_.resize(base);
+                return nullptr;
+            }
+            break;
+        case FRAME_BINARY:
+            left = builder_->binary(frame.op, frame.left, left);
+            PP_EXPR_STAT(stats_.nodes[static_cast<size_t>(ExprKind::Binary)]++);
+            break;
+        case FRAME_INDEX:
+            left = builder_->binary(frame.op, frame.left, left);
+            PP_EXPR_STAT(stats_.nodes[static_cast<size_t>(ExprKind::Binary)]++);
+            if (!consume(TOK_RSQUAR)) {
+                frames_.resize(base);
+                return nullptr;
+            }
+            break;
+        case FRAME_QUESTION:
+            if (!consume(TOK_COLON)) {
+                frames_.resize(base);
+                return nullptr;
+            }
+            frames_.push_back(Frame{ FRAME_COLON, prec, frame.op,
+                std::move(frame.left), std::move(left) });
+            prec = 0;
+            need_operand = true;
+            break;
+        case FRAME_COLON:
+            left = builder_->tenary(frame.op, frame.left, frame.middle, left);
+            PP_EXPR_STAT(stats_.nodes[static_cast<size_t>(ExprKind::Tenary)]++);
+            break;
+        }
+    }
 }
 
-static Expr_t parse_question_expr(Parser& parser, const Token& op_token, const Expr_t& left)
+bool Parser::push_frame(FrameKind kind, int prec, const Token& op, Expr_t left)
 {
-    auto true_expr = parser.parse_expr(0);
-    parser.consume(TOK_COLON);
-    auto false_expr = parser.parse_expr(0);
-    return MakeExpr<TenaryExpr>(
-        op_token,
-        left,
-        true_expr,
-        false_expr
+    if (frames_.size() >= max_depth_) {
+        return false;
+    }
+    PP_EXPR_STAT(size_t capacity = frames_.capacity());
+    frames_.push_back(Frame{ kind, prec, op, std::move(left), nullptr });
+    PP_EXPR_STAT(
+        if (frames_.capacity() != capacity) {
+            note_alloc(frames_.capacity() * sizeof(Frame));
+        }
+        stats_.max_depth = std::max(stats_.max_depth, frames_.size());
     );
+    return true;
 }
 
-/// parse x[n]
-static Expr_t parse_lsquar_expr(Parser& parser, const Token& op_token, const Expr_t& left)
+/// records the first error only, later ones are consequences of it
+Expr_t Parser::fail(size_t base, ParseError code, size_t index, TokenType expected)
 {
-    auto expr = MakeExpr<BinaryExpr>(
-        op_token,
-        left,
-        parser.parse_expr(0)
-    );
-    parser.consume(TOK_RSQUAR);
-    return expr;
+    frames_.resize(base);
+    if (!failed()) {
+        error_.code = code;
+        error_.token_index = index;
+        error_.expected = expected;
+        if (index < count_) {
+            error_.got = tokens_[index];
+        } else {
+            /// empty lexeme just past the last token, so offset() still works
+            std::string_view end = count_ ? tokens_[count_ - 1].lexeme() : std::string_view();
+            error_.got = Token{ TOK_COUNT, std::string_view(end.data() + end.size(), 0) };
+        }
+    }
+    return nullptr;
 }
 
-/// parse x++/x--/x!
-static Expr_t parse_post_unary_expr(Parser& parser, const Token& op_token, const Expr_t& left)
+#if PP_EXPR_INSTRUMENT
+const ParseStats& Parser::stats() const
 {
-    auto expr = MakeExpr<PostfixUnaryExpr>(
-        op_token,
-        left
-    );
-    return expr;
-}
-
-static std::map<TokenType, InfixParser_t> InfixParsers =
-{
-    { TOK_ASSIGN,   &parse_binary_expr_right    },
-    { TOK_QUESTION, &parse_question_expr        },
-    { TOK_PLUS,     &parse_binary_expr_left     },
-    { TOK_MINUS,    &parse_binary_expr_left     },
-    { TOK_STAR,     &parse_binary_expr_left     },
-    { TOK_SLASH,    &parse_binary_expr_left     },
-    { TOK_EQ,       &parse_binary_expr_left     },
-    { TOK_NE,       &parse_binary_expr_left     },
-    { TOK_LT,       &parse_binary_expr_left     },
-    { TOK_LE,       &parse_binary_expr_left     },
-    { TOK_GT,       &parse_binary_expr_left     },
-    { TOK_GE,       &parse_binary_expr_left     },
-    { TOK_AND,      &parse_binary_expr_left     },
-    { TOK_OR,       &parse_binary_expr_left     },
-    { TOK_LSQUAR,   &parse_lsquar_expr          },
-    { TOK_INC,      &parse_post_unary_expr      },
-    { TOK_DEC,      &parse_post_unary_expr      },
-};
-
-Parser::Parser(const std::vector<Token>& tokens)
-    : tokens_(tokens)
-{}
+    return stats_;
+}
 
-Expr_t Parser::parse()
+void Parser::set_stats_sink(ParseStatsSink* sink)
 {
-    Expr_t ast;
-    while (!endof_token()) {
-        ast = parse_expr();
-        break;
-    }
-    return ast;
+    sink_ = sink;
 }
 
-Expr_t Parser::parse_expr(int prec)
+void Parser::begin_stats()
 {
-    auto tok = advance();
-    auto prefix = PrefixParsers[tok.token_type];
-    assert(prefix);
-    auto left = (*prefix)(*this, tok);
+    stats_ = ParseStats{};
+    stats_.lex_ns = take_thread_lex_ns();
+    stats_token_begin_ = curr_;
+    stats_alloc_begin_ = thread_alloc_stats();
+    stats_clock_begin_ = stats_clock_ns();
+}
 
-    while (!endof_token() && cur_op_precedence() > prec)
-    {
-        auto tok = advance();
-        auto infix = InfixParsers[tok.token_type];
-        if (!infix) {
-            break;
-        }
-        left = (*infix)(*this, tok, left);
+void Parser::end_stats()
+{
+    stats_.parse_ns = stats_clock_ns() - stats_clock_begin_;
+    stats_.tokens = curr_ - stats_token_begin_;
+    stats_.allocs = thread_alloc_stats().calls - stats_alloc_begin_.calls;
+    stats_.alloc_bytes = thread_alloc_stats().bytes - stats_alloc_begin_.bytes;
+    stats_.failed = failed();
+    auto* sink = sink_ ? sink_ : default_stats_sink();
+    if (sink) {
+        sink->on_parse(stats_);
     }
-    return left;
 }
+#else
+const ParseStats& Parser::stats() const
+{
+    static const ParseStats no_stats{};
+    return no_stats;
+}
+
+void Parser::set_stats_sink(ParseStatsSink*)
+{}
+#endif
 
 const Token& Parser::advance()
 {
@@ -179,22 +311,32 @@ bool Parser::match(TokenType token_type)
     return true;
 }
 
-void Parser::consume(TokenType token_type)
+bool Parser::consume(TokenType token_type)
 {
-    if (!match(token_type)) {
-        fprintf(stderr, "Error: expected token '%s', got token '%s'\n",
-            Lexeme(token_type), tokens_[curr_].lexeme.c_str());
-        assert(0);
+    if (match(token_type)) {
+        return true;
     }
+    fail(frames_.size(), ParseError::MissingToken, curr_, token_type);
+    return false;
 }
 
 bool Parser::endof_token() const
 {
-    return curr_ >= tokens_.size();
+    return curr_ >= count_;
 }
 
 int Parser::cur_op_precedence() const
 {
-    return get_precedence(tokens_[curr_].token_type);
+    return ops_->infix_precedence(tokens_[curr_].token_type);
+}
+
+ArenaAst parse_arena(const std::vector<Token>& tokens)
+{
+    ArenaAst result;
+    result.arena = std::make_unique<Arena>();
+    ArenaBuilder builder(*result.arena);
+    Parser parser(tokens, builder);
+    result.root = parser.parse();
+    return result;
 }
 }  // namespace pp_expr
@@ -2,8 +2,12 @@
 
 #include "tokens.h"
 #include "ast.h"
+#include "arena.h"
+#include "builder.h"
+#include "diagnostic.h"
+#include "operators.h"
+#include "parse_stats.h"
 
-#include <map>
 #include <string>
 #include <vector>
 
@@ -11,20 +15,104 @@ namespace pp_expr
 {
 class Parser {
 public:
-    explicit Parser(const std::vector<Token>& tokens);
+    /// default limit of operators and parentheses left open at once
+    static constexpr size_t kDefaultMaxDepth = 1 << 16;
 
+    /// parser reads tokens in place, they must outlive the parser
+    explicit Parser(const std::vector<Token>& tokens, AstBuilder& builder = heap_builder());
+    explicit Parser(std::vector<Token>&& tokens, AstBuilder& builder = heap_builder()) = delete;
+    Parser(const Token* tokens, size_t count, AstBuilder& builder = heap_builder());
+
+    /// parse the whole input as one expression; returns null and sets
+    /// diagnostic() on malformed input. Builders that do not return nodes
+    /// (FlatBuilder) give null on success too, so check failed() instead
     Expr_t parse();
+    ParseResult try_parse();
+    /// parse ';' separated expressions to the end, one result each; after
+    /// an error parsing resumes at the next ';', so every error is reported
+    std::vector<ParseResult> parse_all();
 
+    /// iterative, open operators wait on an explicit stack that is kept
+    /// between calls, so nesting depth is bounded by max_depth() and not
+    /// by the thread stack
     Expr_t parse_expr(int prec = 0);
 
     const Token& advance();
     bool match(TokenType token_type);
-    void consume(TokenType token_type);
+    bool consume(TokenType token_type);
     bool endof_token() const;
 
     int cur_op_precedence() const;
+
+    AstBuilder& builder() { return *builder_; }
+
+    /// operators to parse with, which must outlive the parser; tokens have
+    /// to come from a lexer using the same table
+    const OperatorTable& operators() const { return *ops_; }
+    void set_operators(const OperatorTable& ops) { ops_ = &ops; }
+
+    size_t max_depth() const { return max_depth_; }
+    void set_max_depth(size_t depth) { max_depth_ = depth; }
+
+    bool failed() const { return static_cast<bool>(error_); }
+    const Diagnostic& diagnostic() const { return error_; }
+
+    /// stats of the last expression parsed by try_parse()/parse_all(), all
+    /// zero unless built with PP_EXPR_INSTRUMENT
+    const ParseStats& stats() const;
+    /// also report every expression to `sink`, default_stats_sink() if null
+    void set_stats_sink(ParseStatsSink* sink);
 private:
-    std::vector<Token> tokens_;
+    /// operator still waiting for its right operand
+    enum FrameKind : uint8_t {
+        FRAME_UNARY,
+        FRAME_PAREN,
+        FRAME_BINARY,
+        FRAME_INDEX,
+        FRAME_QUESTION,  ///< waiting for the true branch
+        FRAME_COLON,     ///< waiting for the false branch
+    };
+
+    struct Frame {
+        FrameKind kind;
+        int prec;      ///< precedence to resume with once it is reduced
+        Token op;
+        Expr_t left;
+        Expr_t middle;
+    };
+
+    bool push_frame(FrameKind kind, int prec, const Token& op, Expr_t left = nullptr);
+    Expr_t fail(size_t base, ParseError code, size_t index, TokenType expected = TOK_COUNT);
+    /// parse one expression that must end at end of input, or at `;` too
+    /// unless `whole_input`
+    ParseResult parse_one(bool whole_input);
+
+    const Token* tokens_;
+    size_t count_;
     size_t curr_{0};
+    AstBuilder* builder_;
+    const OperatorTable* ops_;
+    size_t max_depth_{kDefaultMaxDepth};
+    std::vector<Frame> frames_;
+    Diagnostic error_;
+#if PP_EXPR_INSTRUMENT
+    void begin_stats();
+    void end_stats();
+
+    ParseStats stats_;
+    ParseStatsSink* sink_{nullptr};
+    size_t stats_token_begin_{0};
+    AllocStats stats_alloc_begin_;
+    uint64_t stats_clock_begin_{0};
+#endif
 };
-}
+
+/// tree parsed into an arena: `root` and every node below it are non-owning
+/// pointers into `arena`, they are all released at once with the result
+struct ArenaAst {
+    std::unique_ptr<Arena> arena;
+    Expr_t root;
+};
+
+ArenaAst parse_arena(const std::vector<Token>& tokens);
+}  // namespace pp_expr
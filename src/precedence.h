@@ -1,43 +1,72 @@
 #pragma once
 
 #include "tokens.h"
-#include <map>
+
+#include <array>
 
 namespace pp_expr
 {
-static int PP = 1;
-static std::map<TokenType, int> binary_op_precedences = {
-    { TOK_ASSIGN,   PP++ },
-    { TOK_QUESTION, PP++ },
-    { TOK_OR,       PP++ },
-    { TOK_AND,      PP++ },
-    { TOK_EQ,       PP   },
-    { TOK_NE,       PP++ },
-    { TOK_LT,       PP   },
-    { TOK_LE,       PP   },
-    { TOK_GT,       PP   },
-    { TOK_GE,       PP++ },
-    { TOK_PLUS,     PP   },
-    { TOK_MINUS,    PP++ },
-    { TOK_STAR,     PP   },
-    { TOK_SLASH,    PP++ },
-    { TOK_LPAREN,   PP   },
-    { TOK_LSQUAR,   PP   },
-    { TOK_INC,      PP   },
-    { TOK_DEC,      PP   },
+/// operator binding power, higher binds tighter, 0 for non operators;
+/// levels are spaced so user operators (operators.h) can go in between
+enum Precedence {
+    PREC_NONE = 0,
+    PREC_ASSIGN = 10,           // =
+    PREC_TENARY = 20,           // ?:
+    PREC_OR = 30,               // ||
+    PREC_AND = 40,              // &&
+    PREC_EQUALITY = 50,         // == !=
+    PREC_RELATIONAL = 60,       // < <= > >=
+    PREC_ADDITIVE = 70,         // + -
+    PREC_MULTIPLICATIVE = 80,   // * /
+    PREC_POSTFIX = 90,          // () [] ++ --
+    PREC_UNARY = PREC_POSTFIX,
 };
 
-static std::map<TokenType, int> unary_op_precedences = {
-    { TOK_PLUS,         PP },
-    { TOK_MINUS,        PP },
-    { TOK_STAR,         PP },
-    { TOK_AMPERSAND,    PP },
-    { TOK_INC,          PP },
-    { TOK_DEC,          PP },
-};
+/// dense tables indexed by TokenType, built at compile time and read only,
+/// so lookups are O(1) and safe from any number of threads
+using PrecedenceTable = std::array<int, TOK_COUNT>;
 
-inline int get_precedence(const TokenType& token_type)
+constexpr PrecedenceTable make_binary_op_precedences()
 {
-    return binary_op_precedences[token_type];
+    PrecedenceTable table{};
+    table[TOK_ASSIGN]   = PREC_ASSIGN;
+    table[TOK_QUESTION] = PREC_TENARY;
+    table[TOK_OR]       = PREC_OR;
+    table[TOK_AND]      = PREC_AND;
+    table[TOK_EQ]       = PREC_EQUALITY;
+    table[TOK_NE]       = PREC_EQUALITY;
+    table[TOK_LT]       = PREC_RELATIONAL;
+    table[TOK_LE]       = PREC_RELATIONAL;
+    table[TOK_GT]       = PREC_RELATIONAL;
+    table[TOK_GE]       = PREC_RELATIONAL;
+    table[TOK_PLUS]     = PREC_ADDITIVE;
+    table[TOK_MINUS]    = PREC_ADDITIVE;
+    table[TOK_STAR]     = PREC_MULTIPLICATIVE;
+    table[TOK_SLASH]    = PREC_MULTIPLICATIVE;
+    table[TOK_LPAREN]   = PREC_POSTFIX;
+    table[TOK_LSQUAR]   = PREC_POSTFIX;
+    table[TOK_INC]      = PREC_POSTFIX;
+    table[TOK_DEC]      = PREC_POSTFIX;
+    return table;
+}
+
+constexpr PrecedenceTable make_unary_op_precedences()
+{
+    PrecedenceTable table{};
+    table[TOK_PLUS]      = PREC_UNARY;
+    table[TOK_MINUS]     = PREC_UNARY;
+    table[TOK_STAR]      = PREC_UNARY;
+    table[TOK_AMPERSAND] = PREC_UNARY;
+    table[TOK_INC]       = PREC_UNARY;
+    table[TOK_DEC]       = PREC_UNARY;
+    return table;
 }
+
+inline constexpr PrecedenceTable binary_op_precedences = make_binary_op_precedences();
+inline constexpr PrecedenceTable unary_op_precedences = make_unary_op_precedences();
+
+constexpr int get_precedence(TokenType token_type)
+{
+    return binary_op_precedences[token_type];
 }
+}  // namespace pp_expr
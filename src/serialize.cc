@@ -0,0 +1,203 @@
+#include "serialize.h"
+#include "visitor.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace pp_expr
+{
+/// room for any double in %g or shortest round trip form
+static const size_t kNumberChars = 32;
+
+char* TextBuffer::reserve(size_t n)
+{
+    if (!fixed_ && size_ + n > capacity_) {
+        storage_.resize(std::max(size_ + n, capacity_ * 2 + 64));
+        data_ = storage_.data();
+        capacity_ = storage_.size();
+    }
+    return size_ + n <= capacity_ ? data_ + size_ : nullptr;
+}
+
+void TextBuffer::append(std::string_view text)
+{
+    if (char* dst = reserve(text.size())) {
+        std::memcpy(dst, text.data(), text.size());
+    } else if (size_ < capacity_) {
+        std::memcpy(data_ + size_, text.data(), capacity_ - size_);
+    }
+    size_ += text.size();
+}
+
+void TextBuffer::append(char c)
+{
+    if (char* dst = reserve(1)) {
+        *dst = c;
+    }
+    size_++;
+}
+
+void TextBuffer::append_number(double value)
+{
+    char text[kNumberChars];
+    auto result = std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6);
+    append(std::string_view(text, result.ptr - text));
+}
+
+void TextBuffer::append_exact(double value)
+{
+    char text[kNumberChars];
+    auto result = std::to_chars(text, text + sizeof(text), value);
+    append(std::string_view(text, result.ptr - text));
+}
+
+namespace
+{
+class SexprWriter : public ExprVisitor<SexprWriter> {
+public:
+    explicit SexprWriter(TextBuffer& out) : out_(out) {}
+
+    void visit_number(const Number& expr) { out_.append_number(expr.value()); }
+    void visit_ident(const Ident& expr) { out_.append(expr.value()); }
+    void visit_unary(const UnaryExpr& expr) {
+        out_.append('(');
+        out_.append(expr.op().lexeme());
+        out_.append(' ');
+        visit(*expr.operand());
+        out_.append(')');
+    }
+    void visit_postfix_unary(const PostfixUnaryExpr& expr) {
+        out_.append('(');
+        visit(*expr.operand());
+        out_.append(' ');
+        out_.append(expr.op().lexeme());
+        out_.append(')');
+    }
+    void visit_binary(const BinaryExpr& expr) {
+        out_.append('(');
+        out_.append(expr.op().lexeme());
+        out_.append(' ');
+        visit(*expr.left());
+        out_.append(' ');
+        visit(*expr.right());
+        out_.append(')');
+    }
+    void visit_tenary(const TenaryExpr& expr) {
+        out_.append('(');
+        out_.append(expr.op().lexeme());
+        out_.append(' ');
+        visit(*expr.operand1());
+        out_.append(' ');
+        visit(*expr.operand2());
+        out_.append(' ');
+        visit(*expr.operand3());
+        out_.append(')');
+    }
+private:
+    TextBuffer& out_;
+};
+
+class JsonWriter : public ExprVisitor<JsonWriter> {
+public:
+    explicit JsonWriter(TextBuffer& out) : out_(out) {}
+
+    void visit_number(const Number& expr) {
+        out_.append("{\"type\":\"number\",\"value\":");
+        double value = expr.value();
+        if (std::isfinite(value)) {
+            out_.append_exact(value);
+        } else {
+            out_.append(std::isnan(value) ? "\"nan\"" : value > 0 ? "\"inf\"" : "\"-inf\"");
+        }
+        out_.append('}');
+    }
+    void visit_ident(const Ident& expr) {
+        out_.append("{\"type\":\"ident\",\"name\":");
+        string(expr.value());
+        out_.append('}');
+    }
+    void visit_unary(const UnaryExpr& expr) {
+        unary("unary", expr);
+    }
+    void visit_postfix_unary(const PostfixUnaryExpr& expr) {
+        unary("postfix", expr);
+    }
+    void visit_binary(const BinaryExpr& expr) {
+        head("binary", expr.op());
+        out_.append(",\"left\":");
+        visit(*expr.left());
+        out_.append(",\"right\":");
+        visit(*expr.right());
+        out_.append('}');
+    }
+    void visit_tenary(const TenaryExpr& expr) {
+        head("tenary", expr.op());
+        out_.append(",\"cond\":");
+        visit(*expr.operand1());
+        out_.append(",\"then\":");
+        visit(*expr.operand2());
+        out_.append(",\"else\":");
+        visit(*expr.operand3());
+        out_.append('}');
+    }
+private:
+    void head(const char* type, const Token& op) {
+        out_.append("{\"type\":\"");
+        out_.append(type);
+        out_.append("\",\"op\":");
+        string(op.lexeme());
+    }
+    void unary(const char* type, const UnaryExpr& expr) {
+        head(type, expr.op());
+        out_.append(",\"operand\":");
+        visit(*expr.operand());
+        out_.append('}');
+    }
+    void string(std::string_view text) {
+        static const char hex[] = "0123456789abcdef";
+        out_.append('"');
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out_.append('\\');
+                out_.append(c);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                out_.append("\\u00");
+                out_.append(hex[(c >> 4) & 0xf]);
+                out_.append(hex[c & 0xf]);
+            } else {
+                out_.append(c);
+            }
+        }
+        out_.append('"');
+    }
+
+    TextBuffer& out_;
+};
+}  // namespace
+
+void write_sexpr(const Expr& expr, TextBuffer& out)
+{
+    SexprWriter(out).visit(expr);
+}
+
+void write_json(const Expr& expr, TextBuffer& out)
+{
+    JsonWriter(out).visit(expr);
+}
+
+std::string to_sexpr(const Expr& expr)
+{
+    TextBuffer out;
+    write_sexpr(expr, out);
+    return out.str();
+}
+
+std::string to_json(const Expr& expr)
+{
+    TextBuffer out;
+    write_json(expr, out);
+    return out.str();
+}
+}  // namespace pp_expr
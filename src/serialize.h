@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ast.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace pp_expr
+{
+/// output for the serializers: either growable, or a fixed span given by
+/// the caller. A fixed buffer never writes past its capacity; like snprintf
+/// it keeps counting, so size() is the length the full text needs.
+class TextBuffer {
+public:
+    TextBuffer() = default;
+    TextBuffer(char* data, size_t capacity) : data_(data), capacity_(capacity), fixed_(true) {}
+
+    TextBuffer(const TextBuffer&) = delete;
+    TextBuffer& operator =(const TextBuffer&) = delete;
+
+    void append(std::string_view text);
+    void append(char c);
+    /// formatted like `std::ostream << value` with default flags (%g)
+    void append_number(double value);
+    /// shortest text that reads back as `value`
+    void append_exact(double value);
+
+    size_t size() const { return size_; }
+    bool overflowed() const { return size_ > capacity_; }
+    /// what was written, cut at the capacity if overflowed
+    std::string_view view() const { return std::string_view(data_, size_ < capacity_ ? size_ : capacity_); }
+    std::string str() const { return std::string(view()); }
+    void clear() { size_ = 0; }
+private:
+    char* reserve(size_t n);
+
+    char* data_{nullptr};
+    size_t size_{0};
+    size_t capacity_{0};
+    bool fixed_{false};
+    std::string storage_;
+};
+
+/// same text as `os << expr`
+void write_sexpr(const Expr& expr, TextBuffer& out);
+/// {"type":"binary","op":"+","left":{...},"right":{...}}; types are number,
+/// ident, unary, postfix, binary and tenary (with cond/then/else); numbers
+/// are written exactly, non finite ones as the strings "inf", "-inf", "nan"
+void write_json(const Expr& expr, TextBuffer& out);
+
+std::string to_sexpr(const Expr& expr);
+std::string to_json(const Expr& expr);
+}  // namespace pp_expr
@@ -0,0 +1,417 @@
+#pragma once
+
+#include "ast.h"
+#include "builder.h"
+#include "eval.h"
+#include "precedence.h"
+#include "tokens.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace pp_expr
+{
+/// expressions fixed in source code, parsed at compile time:
+///
+///     constexpr auto f = PP_EXPR_STATIC("a * b + (c < 0 ? -c : c)");
+///     double r = f(2, 3, -1);        // variables in order of first use
+///
+/// Parsing follows precedence.h like Parser, malformed text fails to
+/// compile, and evaluation is one inlined function per node with the same
+/// semantics as evaluate(). Variables are scalars: indexing and the pointer
+/// operators don't compile.
+namespace ct
+{
+struct Node {
+    ExprKind kind{ExprKind::Number};
+    TokenType op{TOK_NUM};
+    uint16_t child[3]{};
+    uint16_t var{0};    ///< Ident: index into Ast::vars
+    double value{0};    ///< Number
+};
+
+/// nodes in post-order, at most one per character of source
+template <size_t N>
+struct Ast {
+    Node nodes[N]{};
+    size_t size{0};
+    uint16_t root{0};
+    std::string_view vars[N]{};
+    size_t var_count{0};
+};
+
+/// constexpr counterpart of tokenize(), same token grammar
+struct Scanner {
+    std::string_view source;
+    size_t pos{0};
+
+    static constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+    static constexpr bool is_ident_start(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+    static constexpr bool is_ident_char(char c) { return is_ident_start(c) || is_digit(c); }
+    static constexpr bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    constexpr char at(size_t i) const { return i < source.size() ? source[i] : '\0'; }
+
+    /// next token without consuming it, TOK_COUNT at end of input
+    constexpr Token peek() const {
+        size_t i = pos;
+        while (i < source.size() && is_space(source[i])) {
+            i++;
+        }
+        if (i >= source.size()) {
+            return Token{ TOK_COUNT, source.substr(i, 0) };
+        }
+        auto token = [&](TokenType type, size_t len) { return Token{ type, source.substr(i, len) }; };
+        const char c = source[i];
+        const char c2 = at(i + 1);
+        if (is_digit(c) || (c == '.' && is_digit(c2))) {
+            size_t n = 0;
+            while (is_digit(at(i + n))) n++;
+            if (at(i + n) == '.') {
+                n++;
+                while (is_digit(at(i + n))) n++;
+            }
+            if (at(i + n) == 'e' || at(i + n) == 'E') {
+                size_t m = n + 1;
+                if (at(i + m) == '+' || at(i + m) == '-') m++;
+                if (is_digit(at(i + m))) {
+                    while (is_digit(at(i + m))) m++;
+                    n = m;
+                }
+            }
+            return token(TOK_NUM, n);
+        }
+        if (is_ident_start(c)) {
+            size_t n = 1;
+            while (is_ident_char(at(i + n))) n++;
+            return token(TOK_ID, n);
+        }
+        switch (c) {
+        case '+': return c2 == '+' ? token(TOK_INC, 2) : token(TOK_PLUS, 1);
+        case '-': return c2 == '-' ? token(TOK_DEC, 2) : token(TOK_MINUS, 1);
+        case '*': return token(TOK_STAR, 1);
+        case '/': return token(TOK_SLASH, 1);
+        case '&': return c2 == '&' ? token(TOK_AND, 2) : token(TOK_AMPERSAND, 1);
+        case '=': return c2 == '=' ? token(TOK_EQ, 2) : token(TOK_ASSIGN, 1);
+        case '!': return c2 == '=' ? token(TOK_NE, 2) : token(TOK_INVALID, 1);
+        case '<': return c2 == '=' ? token(TOK_LE, 2) : token(TOK_LT, 1);
+        case '>': return c2 == '=' ? token(TOK_GE, 2) : token(TOK_GT, 1);
+        case '|': return c2 == '|' ? token(TOK_OR, 2) : token(TOK_INVALID, 1);
+        case '?': return token(TOK_QUESTION, 1);
+        case ':': return token(TOK_COLON, 1);
+        case '(': return token(TOK_LPAREN, 1);
+        case ')': return token(TOK_RPAREN, 1);
+        case '[': return token(TOK_LSQUAR, 1);
+        case ']': return token(TOK_RSQUAR, 1);
+        case ';': return token(TOK_SEMI, 1);
+        default: return token(TOK_INVALID, 1);
+        }
+    }
+
+    constexpr Token next() {
+        Token token = peek();
+        pos = static_cast<size_t>(token.lexeme().data() - source.data()) + token.lexeme().size();
+        return token;
+    }
+};
+
+/// decimal literal to double: correctly rounded like the runtime parse while
+/// the digits fit in 53 bits and the power of ten is within 1e22, otherwise
+/// it can be off in the last bits
+constexpr double parse_number(std::string_view text)
+{
+    uint64_t mantissa = 0;
+    int exp10 = 0;
+    size_t i = 0;
+    auto digit = [&](char c) {
+        if (mantissa < 1000000000000000000ull) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(c - '0');
+            return 0;
+        }
+        return 1;  // dropped, only shifts the exponent
+    };
+    for (; i < text.size() && Scanner::is_digit(text[i]); i++) {
+        exp10 += digit(text[i]);
+    }
+    if (i < text.size() && text[i] == '.') {
+        for (i++; i < text.size() && Scanner::is_digit(text[i]); i++) {
+            exp10 -= 1 - digit(text[i]);
+        }
+    }
+    if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+        bool negative = text[++i] == '-';
+        if (text[i] == '+' || text[i] == '-') {
+            i++;
+        }
+        int e = 0;
+        for (; i < text.size(); i++) {
+            e = e < 10000 ? e * 10 + (text[i] - '0') : e;
+        }
+        exp10 += negative ? -e : e;
+    }
+    double value = static_cast<double>(mantissa);
+    double scale = 1;
+    int n = exp10 < 0 ? -exp10 : exp10;
+    for (double p = 10; n > 0; n >>= 1, p *= p) {
+        if (n & 1) {
+            scale *= p;
+        }
+    }
+    return exp10 < 0 ? value / scale : value * scale;
+}
+
+/// recursive Pratt parser over Scanner, mirrors Parser::parse_expr; errors
+/// are thrown, which at compile time makes the expression ill-formed
+template <size_t N>
+class StaticParser {
+public:
+    explicit constexpr StaticParser(std::string_view source) : scanner_{ source } {}
+
+    constexpr Ast<N> parse() {
+        ast_.root = parse_expr(0);
+        if (scanner_.peek().token_type != TOK_COUNT) {
+            throw std::invalid_argument("static expression: unexpected token after expression");
+        }
+        return ast_;
+    }
+private:
+    constexpr uint16_t add(Node node) {
+        ast_.nodes[ast_.size] = node;
+        return static_cast<uint16_t>(ast_.size++);
+    }
+
+    constexpr uint16_t intern(std::string_view name) {
+        for (size_t i = 0; i < ast_.var_count; i++) {
+            if (ast_.vars[i] == name) {
+                return static_cast<uint16_t>(i);
+            }
+        }
+        ast_.vars[ast_.var_count] = name;
+        return static_cast<uint16_t>(ast_.var_count++);
+    }
+
+    constexpr void expect(TokenType type) {
+        if (scanner_.next().token_type != type) {
+            throw std::invalid_argument("static expression: missing ')', ']' or ':'");
+        }
+    }
+
+    constexpr uint16_t parse_expr(int prec) {
+        Token tok = scanner_.next();
+        uint16_t left = 0;
+        switch (tok.token_type) {
+        case TOK_ID:
+            left = add(Node{ ExprKind::Ident, TOK_ID, {}, intern(tok.lexeme()), 0 });
+            break;
+        case TOK_NUM:
+            left = add(Node{ ExprKind::Number, TOK_NUM, {}, 0, parse_number(tok.lexeme()) });
+            break;
+        case TOK_LPAREN:
+            left = parse_expr(0);
+            expect(TOK_RPAREN);
+            break;
+        case TOK_COUNT:
+            throw std::invalid_argument("static expression: unexpected end of input");
+        default: {
+            if (unary_op_precedences[tok.token_type] == PREC_NONE) {
+                throw std::invalid_argument("static expression: unexpected token");
+            }
+            uint16_t operand = parse_expr(unary_op_precedences[tok.token_type] - 1);
+            left = add(Node{ ExprKind::Unary, tok.token_type, { operand }, 0, 0 });
+            break;
+        }
+        }
+
+        for (;;) {
+            TokenType type = scanner_.peek().token_type;
+            if (type == TOK_COUNT || type == TOK_LPAREN || get_precedence(type) <= prec) {
+                return left;
+            }
+            scanner_.next();
+            int op_prec = get_precedence(type);
+            switch (type) {
+            case TOK_INC:
+            case TOK_DEC:
+                left = add(Node{ ExprKind::PostfixUnary, type, { left }, 0, 0 });
+                break;
+            case TOK_LSQUAR: {
+                uint16_t index = parse_expr(0);
+                expect(TOK_RSQUAR);
+                left = add(Node{ ExprKind::Binary, type, { left, index }, 0, 0 });
+                break;
+            }
+            case TOK_QUESTION: {
+                uint16_t then = parse_expr(0);
+                expect(TOK_COLON);
+                uint16_t otherwise = parse_expr(0);
+                left = add(Node{ ExprKind::Tenary, type, { left, then, otherwise }, 0, 0 });
+                break;
+            }
+            default: {
+                /// right associative for assignment: a = b = c => a = (b = c)
+                uint16_t right = parse_expr(type == TOK_ASSIGN ? op_prec - 1 : op_prec);
+                left = add(Node{ ExprKind::Binary, type, { left, right }, 0, 0 });
+                break;
+            }
+            }
+        }
+    }
+
+    Scanner scanner_;
+    Ast<N> ast_{};
+};
+
+template <typename Source>
+constexpr auto parse_source()
+{
+    constexpr std::string_view source = Source::get();
+    static_assert(source.size() < 65535, "static expression too long");
+    return StaticParser<source.size() + 1>(source).parse();
+}
+
+template <typename Source>
+inline constexpr auto ast = parse_source<Source>();
+
+template <TokenType op>
+inline constexpr bool unsupported = false;
+
+/// evaluation of node I, resolved at compile time down to the operator
+template <typename Source, uint16_t I>
+struct Eval {
+    static constexpr const Node& node = ast<Source>.nodes[I];
+
+    template <typename Vars>
+    static constexpr double run(Vars& vars) {
+        if constexpr (node.kind == ExprKind::Number) {
+            return node.value;
+        } else if constexpr (node.kind == ExprKind::Ident) {
+            return vars[node.var];
+        } else if constexpr (node.kind == ExprKind::Unary) {
+            if constexpr (node.op == TOK_PLUS) {
+                return operand<0>(vars);
+            } else if constexpr (node.op == TOK_MINUS) {
+                return -operand<0>(vars);
+            } else if constexpr (node.op == TOK_INC) {
+                return ++lvalue<0>(vars);
+            } else if constexpr (node.op == TOK_DEC) {
+                return --lvalue<0>(vars);
+            } else {
+                static_assert(unsupported<node.op>, "pointer operators have no numeric meaning");
+            }
+        } else if constexpr (node.kind == ExprKind::PostfixUnary) {
+            if constexpr (node.op == TOK_INC) {
+                return lvalue<0>(vars)++;
+            } else {
+                return lvalue<0>(vars)--;
+            }
+        } else if constexpr (node.kind == ExprKind::Tenary) {
+            return operand<0>(vars) != 0 ? operand<1>(vars) : operand<2>(vars);
+        } else if constexpr (node.op == TOK_AND) {
+            return operand<0>(vars) != 0 && operand<1>(vars) != 0;
+        } else if constexpr (node.op == TOK_OR) {
+            return operand<0>(vars) != 0 || operand<1>(vars) != 0;
+        } else if constexpr (node.op == TOK_ASSIGN) {
+            /// right operand first, as evaluate() does
+            double value = operand<1>(vars);
+            return lvalue<0>(vars) = value;
+        } else if constexpr (node.op == TOK_LSQUAR) {
+            static_assert(unsupported<node.op>, "static expression variables can't be indexed");
+        } else {
+            double left = operand<0>(vars);
+            return apply_binary(node.op, left, operand<1>(vars));
+        }
+    }
+private:
+    template <int n, typename Vars>
+    static constexpr double operand(Vars& vars) {
+        return Eval<Source, node.child[n]>::run(vars);
+    }
+
+    template <int n, typename Vars>
+    static constexpr double& lvalue(Vars& vars) {
+        constexpr const Node& target = ast<Source>.nodes[node.child[n]];
+        static_assert(target.kind == ExprKind::Ident, "expression is not assignable");
+        return vars[target.var];
+    }
+};
+
+/// runtime tree of node I, for inspection and comparison with Parser
+template <size_t N>
+Expr_t build(const Ast<N>& ast, uint16_t i, AstBuilder& builder)
+{
+    const Node& node = ast.nodes[i];
+    Token op{ node.op, {} };
+    switch (node.kind) {
+    case ExprKind::Number:
+        return builder.number(node.value);
+    case ExprKind::Ident:
+        return builder.ident(ast.vars[node.var]);
+    case ExprKind::Unary:
+        return builder.unary(canonical(op), build(ast, node.child[0], builder));
+    case ExprKind::PostfixUnary:
+        return builder.postfix_unary(canonical(op), build(ast, node.child[0], builder));
+    case ExprKind::Binary:
+        return builder.binary(canonical(op), build(ast, node.child[0], builder),
+            build(ast, node.child[1], builder));
+    case ExprKind::Tenary:
+        return builder.tenary(canonical(op), build(ast, node.child[0], builder),
+            build(ast, node.child[1], builder), build(ast, node.child[2], builder));
+    }
+    return nullptr;
+}
+}  // namespace ct
+
+/// an expression parsed at compile time, see PP_EXPR_STATIC
+template <typename Source>
+class StaticExpr {
+public:
+    /// distinct variables, in order of first appearance
+    static constexpr size_t arity = ct::ast<Source>.var_count;
+
+    static constexpr std::string_view source() { return Source::get(); }
+    static constexpr std::string_view variable(size_t i) { return ct::ast<Source>.vars[i]; }
+    /// position of variable `name`, arity if it doesn't appear
+    static constexpr size_t index_of(std::string_view name) {
+        size_t i = 0;
+        while (i < arity && variable(i) != name) {
+            i++;
+        }
+        return i;
+    }
+
+    /// evaluate with variables passed by value, in order of first appearance
+    template <typename... Args>
+    constexpr double operator ()(Args... args) const {
+        static_assert(sizeof...(Args) == arity, "one argument per variable");
+        double vars[arity + 1] = { static_cast<double>(args)... };
+        return ct::Eval<Source, ct::ast<Source>.root>::run(vars);
+    }
+
+    /// evaluate with variables read from and assigned through `vars`,
+    /// indexed like variable()
+    double eval(double* vars) const {
+        return ct::Eval<Source, ct::ast<Source>.root>::run(vars);
+    }
+
+    /// the same tree Parser builds from source()
+    static Expr_t to_ast(AstBuilder& builder = heap_builder()) {
+        return ct::build(ct::ast<Source>, ct::ast<Source>.root, builder);
+    }
+};
+}  // namespace pp_expr
+
+/// StaticExpr for a string literal; the literal is carried in a local type
+/// because C++17 can't take strings as template arguments
+#define PP_EXPR_STATIC(literal)                                                  \
+    ([] {                                                                        \
+        struct PpExprSource {                                                    \
+            static constexpr std::string_view get() { return literal; }         \
+        };                                                                       \
+        return ::pp_expr::StaticExpr<PpExprSource>();                            \
+    }())
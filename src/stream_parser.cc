@@ -0,0 +1,74 @@
+#include "stream_parser.h"
+#include "lexer.h"
+#include "parser.h"
+
+namespace pp_expr
+{
+StreamParser::StreamParser(Callback on_expr, size_t max_expr_bytes, AstBuilder& builder)
+    : on_expr_(std::move(on_expr)), max_expr_bytes_(max_expr_bytes), builder_(builder)
+{}
+
+void StreamParser::parse_piece(std::string_view piece)
+{
+    tokens_.clear();
+    tokenize(piece, tokens_, *ops_);
+    if (tokens_.empty()) {
+        return;
+    }
+    Parser parser(tokens_, builder_);
+    parser.set_operators(*ops_);
+    auto result = parser.try_parse();
+    if (result.ok()) {
+        on_expr_(result.ast);
+        return;
+    }
+    failures_++;
+    if (on_error_) {
+        on_error_(result.error, piece);
+    }
+}
+
+void StreamParser::feed(std::string_view chunk)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < chunk.size(); i++) {
+        if (chunk[i] != '\n' && chunk[i] != ';') {
+            continue;
+        }
+        if (skipping_) {
+            skipping_ = false;
+        } else if (pending_.size() + (i - start) > max_expr_bytes_) {
+            oversized_++;
+        } else if (pending_.empty()) {
+            parse_piece(chunk.substr(start, i - start));
+        } else {
+            pending_.append(chunk.data() + start, i - start);
+            parse_piece(pending_);
+        }
+        pending_.clear();
+        start = i + 1;
+    }
+
+    if (skipping_ || start == chunk.size()) {
+        return;
+    }
+    if (pending_.size() + (chunk.size() - start) > max_expr_bytes_) {
+        /// too long to keep, drop it and ignore the rest of it
+        oversized_++;
+        skipping_ = true;
+        pending_.clear();
+        pending_.shrink_to_fit();
+        return;
+    }
+    pending_.append(chunk.data() + start, chunk.size() - start);
+}
+
+void StreamParser::finish()
+{
+    if (!skipping_ && !pending_.empty()) {
+        parse_piece(pending_);
+    }
+    pending_.clear();
+    skipping_ = false;
+}
+}  // namespace pp_expr
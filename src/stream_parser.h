@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ast.h"
+#include "builder.h"
+#include "diagnostic.h"
+#include "operators.h"
+#include "tokens.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pp_expr
+{
+/// push-driven parser over a byte stream of expressions separated by
+/// newlines or semicolons. Chunks may split an expression anywhere, each
+/// expression is parsed and passed to the callback as soon as its separator
+/// arrives. Expressions wholly inside one chunk are parsed in place, only
+/// the unfinished tail is copied and kept until the next chunk, bounded by
+/// `max_expr_bytes`; a longer expression is skipped up to its separator.
+class StreamParser {
+public:
+    using Callback = std::function<void(const Expr_t&)>;
+    /// `source` is the text of the rejected expression, the diagnostic's
+    /// tokens point into it; both are valid only during the call
+    using ErrorCallback = std::function<void(const Diagnostic&, std::string_view source)>;
+
+    explicit StreamParser(Callback on_expr, size_t max_expr_bytes = 64 * 1024,
+        AstBuilder& builder = heap_builder());
+
+    /// malformed expressions are skipped, and reported here if set
+    void on_error(ErrorCallback on_error) { on_error_ = std::move(on_error); }
+    /// lex and parse with user operators, `ops` must outlive the parser
+    void set_operators(const OperatorTable& ops) { ops_ = &ops; }
+
+    /// consume next chunk of the stream
+    void feed(std::string_view chunk);
+    /// end of stream, parse the last expression if it had no separator
+    void finish();
+
+    /// bytes kept between chunks
+    size_t pending_bytes() const { return pending_.size(); }
+    /// expressions dropped for exceeding max_expr_bytes
+    size_t oversized() const { return oversized_; }
+    /// expressions that failed to parse
+    size_t failures() const { return failures_; }
+private:
+    void parse_piece(std::string_view piece);
+
+    Callback on_expr_;
+    ErrorCallback on_error_;
+    size_t max_expr_bytes_;
+    AstBuilder& builder_;
+    const OperatorTable* ops_{&OperatorTable::builtin()};
+    std::string pending_;
+    std::vector<Token> tokens_;
+    bool skipping_{false};
+    size_t oversized_{0};
+    size_t failures_{0};
+};
+}  // namespace pp_expr
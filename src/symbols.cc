@@ -0,0 +1,35 @@
+#include "symbols.h"
+
+#include <atomic>
+
+namespace pp_expr
+{
+SymbolTable::SymbolTable()
+{
+    static std::atomic<uint32_t> next_tag{1};
+    tag_ = next_tag++;
+}
+
+uint32_t SymbolTable::intern(std::string_view name)
+{
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    auto id = static_cast<uint32_t>(names_.size());
+    names_.emplace_back(name);
+    ids_.emplace(names_.back(), id);
+    return id;
+}
+
+uint32_t SymbolTable::find(std::string_view name) const
+{
+    auto it = ids_.find(name);
+    return it == ids_.end() ? kNoSymbol : it->second;
+}
+
+Expr_t SymbolBuilder::ident(std::string_view name, SymbolId)
+{
+    return inner_.ident(name, SymbolId{ symbols_.tag(), symbols_.intern(name) });
+}
+}  // namespace pp_expr
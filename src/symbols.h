@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ast.h"
+#include "builder.h"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace pp_expr
+{
+/// interned identifier names, ids are dense and assigned in order of first
+/// appearance. Not thread safe.
+class SymbolTable {
+public:
+    SymbolTable();
+    /// map keys view the names, and the tag identifies this table
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator =(const SymbolTable&) = delete;
+
+    /// id of `name`, added if it is new
+    uint32_t intern(std::string_view name);
+    /// id of `name`, kNoSymbol if it was never interned
+    uint32_t find(std::string_view name) const;
+
+    const std::string& name(uint32_t id) const { return names_[id]; }
+    size_t size() const { return names_.size(); }
+    /// unique per table in the process, never 0
+    uint32_t tag() const { return tag_; }
+private:
+    uint32_t tag_;
+    /// deque keeps every name in place, so the map keys can view them
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
+
+/// interns every identifier the parser builds and has `inner` create it
+/// with its SymbolId; other nodes are passed straight through
+class SymbolBuilder : public AstBuilder {
+public:
+    explicit SymbolBuilder(SymbolTable& symbols, AstBuilder& inner = heap_builder())
+        : symbols_(symbols), inner_(inner) {}
+
+    Expr_t number(double value) override {
+        return inner_.number(value);
+    }
+    Expr_t ident(std::string_view name, SymbolId symbol = {}) override;
+    Expr_t unary(const Token& op, const Expr_t& operand) override {
+        return inner_.unary(op, operand);
+    }
+    Expr_t postfix_unary(const Token& op, const Expr_t& operand) override {
+        return inner_.postfix_unary(op, operand);
+    }
+    Expr_t binary(const Token& op, const Expr_t& left, const Expr_t& right) override {
+        return inner_.binary(op, left, right);
+    }
+    Expr_t tenary(const Token& op, const Expr_t& operand1,
+        const Expr_t& operand2, const Expr_t& operand3) override {
+        return inner_.tenary(op, operand1, operand2, operand3);
+    }
+
+    SymbolTable& symbols() { return symbols_; }
+private:
+    SymbolTable& symbols_;
+    AstBuilder& inner_;
+};
+}  // namespace pp_expr
@@ -0,0 +1,130 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace pp_expr
+{
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers_[i]->thread = std::thread([this, i] { run_worker(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wakeup_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+void ThreadPool::push(size_t worker, Task task)
+{
+    {
+        /// counted first and under sleep mutex, so a worker checking
+        /// queued_ can't miss the task
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        queued_++;
+    }
+    std::lock_guard<std::mutex> lock(workers_[worker]->mutex);
+    workers_[worker]->tasks.push_back(std::move(task));
+}
+
+bool ThreadPool::take(size_t worker, Task& task)
+{
+    const size_t count = workers_.size();
+    for (size_t n = 0; n < count; n++) {
+        auto& victim = *workers_[(worker + n) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) {
+            continue;
+        }
+        if (n == 0) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+        } else {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+        queued_--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run_worker(size_t worker)
+{
+    for (;;) {
+        Task task;
+        if (take(worker, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wakeup_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& fn)
+{
+    if (count == 0) {
+        return;
+    }
+    std::atomic<size_t> remaining{count};
+    std::mutex done_mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+
+    const size_t workers = workers_.size();
+    for (size_t w = 0; w < workers; w++) {
+        size_t begin = count * w / workers;
+        size_t end = count * (w + 1) / workers;
+        for (size_t i = begin; i < end; i++) {
+            push(w, [&, i] {
+                /// a throwing task still counts down, the latch outlives it
+                std::exception_ptr thrown;
+                try {
+                    fn(i);
+                } catch (...) {
+                    thrown = std::current_exception();
+                }
+                /// under lock, the waiter can't return and destroy the
+                /// latch before this task is done with it
+                std::lock_guard<std::mutex> lock(done_mutex);
+                if (thrown && !error) {
+                    error = thrown;
+                }
+                if (--remaining == 0) {
+                    done.notify_all();
+                }
+            });
+        }
+    }
+    wakeup_.notify_all();
+
+    Task task;
+    while (remaining > 0 && take(0, task)) {
+        task();
+    }
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&] { return remaining == 0; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+}  // namespace pp_expr
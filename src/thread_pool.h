@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pp_expr
+{
+/// work-stealing thread pool: every worker owns a task deque, takes its own
+/// tasks from the back and steals from the front of other deques when idle
+class ThreadPool {
+public:
+    /// 0 uses hardware concurrency
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator =(const ThreadPool&) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    /// run fn(i) for every i in [0, count) and wait for all of them;
+    /// indices are dealt to workers in contiguous ranges, the calling
+    /// thread helps running tasks while it waits. If fn throws, the other
+    /// indices still run and the first exception is rethrown afterwards
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+private:
+    using Task = std::function<void()>;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void push(size_t worker, Task task);
+    /// own deque first, then steal
+    bool take(size_t worker, Task& task);
+    void run_worker(size_t worker);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wakeup_;
+    std::atomic<size_t> queued_{0};
+    bool stop_{false};
+};
+}  // namespace pp_expr
@@ -1,11 +1,13 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
 #include <cassert>
 
 namespace pp_expr
 {
-enum TokenType {
+enum TokenType : uint8_t {
     TOK_PLUS = 0,   // +
     TOK_MINUS,      // -
     TOK_STAR,       // *
@@ -28,15 +30,44 @@ enum TokenType {
     TOK_RPAREN,     // )
     TOK_LSQUAR,     // [
     TOK_RSQUAR,     // ]
+    TOK_SEMI,       // ; ends an expression
     TOK_NUM,        // Number
     TOK_ID,         // Identifier
+    TOK_INVALID,    // character that starts no token
+    TOK_COUNT,      // number of token types, not a token
+    TOK_USER,       // first of the user defined operators, see operators.h
 };
 
+/// bound of all token types, built-in and user defined
+static constexpr size_t kTokenTypeLimit = 256;
+
+/// spelling of a user defined operator, "" if `token_type` is not one
+const char* user_operator_spelling(TokenType token_type);
+
+/// lexeme doesn't own its text, it refers to the source buffer the token was
+/// scanned from (or to a string literal for hand built tokens). Plain 16
+/// bytes, so token vectors can be copied with memcpy; a lexeme is at most
+/// 4GB long
 struct Token {
+    Token() = default;
+    constexpr Token(TokenType type, std::string_view lexeme)
+        : text_(lexeme.data()), size_(static_cast<uint32_t>(lexeme.size())), token_type(type)
+    {}
+
+    constexpr std::string_view lexeme() const { return std::string_view(text_, size_); }
+    /// position of the token in `source`, the buffer it was scanned from
+    size_t offset(std::string_view source) const {
+        return static_cast<size_t>(text_ - source.data());
+    }
+
+    const char* text_;
+    uint32_t size_;
     TokenType token_type;
-    std::string lexeme;
 };
 
+static_assert(sizeof(Token) <= 16, "Token should stay two words");
+static_assert(std::is_trivially_copyable_v<Token>, "Token should be memcpy-able");
+
 inline const char* Lexeme(TokenType token_type)
 {
     switch (token_type) {
@@ -62,7 +93,11 @@ inline const char* Lexeme(TokenType token_type)
     case TOK_RPAREN: return ")";
     case TOK_LSQUAR: return "[";
     case TOK_RSQUAR: return "]";
+    case TOK_SEMI: return ";";
     default:
+        if (token_type >= TOK_USER) {
+            return user_operator_spelling(token_type);
+        }
         assert(0);
     }
     return "";
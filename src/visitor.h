@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ast.h"
+
+#include <cassert>
+#include <utility>
+
+namespace pp_expr
+{
+/// true if `expr` is a T (UnaryExpr also matches postfix nodes)
+template <typename T>
+inline bool isa(const Expr& expr)
+{
+    return T::classof(expr.kind());
+}
+
+/// downcast checked against kind() in debug builds, a plain static_cast
+/// otherwise; no RTTI involved
+template <typename T>
+inline const T& expr_cast(const Expr& expr)
+{
+    assert(isa<T>(expr) && "expr_cast to wrong node type");
+    return static_cast<const T&>(expr);
+}
+
+/// null if `expr` is null or not a T
+template <typename T>
+inline const T* dyn_expr_cast(const Expr* expr)
+{
+    return expr && isa<T>(*expr) ? static_cast<const T*>(expr) : nullptr;
+}
+
+/// call `fn` with `expr` as its concrete node type, selected by a switch on
+/// kind(); every overload (or a generic lambda) must return the same type
+template <typename F>
+inline decltype(auto) visit_expr(const Expr& expr, F&& fn)
+{
+    switch (expr.kind()) {
+    case ExprKind::Number: return fn(static_cast<const Number&>(expr));
+    case ExprKind::Ident: return fn(static_cast<const Ident&>(expr));
+    case ExprKind::Unary: return fn(static_cast<const UnaryExpr&>(expr));
+    case ExprKind::PostfixUnary: return fn(static_cast<const PostfixUnaryExpr&>(expr));
+    case ExprKind::Binary: return fn(static_cast<const BinaryExpr&>(expr));
+    case ExprKind::Tenary: break;
+    }
+    return fn(static_cast<const TenaryExpr&>(expr));
+}
+
+/// statically dispatched visitor: Derived defines
+///     R visit_number(const Number&);
+///     R visit_ident(const Ident&);
+///     R visit_unary(const UnaryExpr&);
+///     R visit_binary(const BinaryExpr&);
+///     R visit_tenary(const TenaryExpr&);
+/// and optionally visit_postfix_unary(), which defaults to visit_unary().
+/// visit() switches on the node kind, there are no virtual calls.
+template <typename Derived, typename R = void>
+class ExprVisitor {
+public:
+    R visit(const Expr& expr) {
+        auto& self = static_cast<Derived&>(*this);
+        switch (expr.kind()) {
+        case ExprKind::Number: return self.visit_number(static_cast<const Number&>(expr));
+        case ExprKind::Ident: return self.visit_ident(static_cast<const Ident&>(expr));
+        case ExprKind::Unary: return self.visit_unary(static_cast<const UnaryExpr&>(expr));
+        case ExprKind::PostfixUnary:
+            return self.visit_postfix_unary(static_cast<const PostfixUnaryExpr&>(expr));
+        case ExprKind::Binary: return self.visit_binary(static_cast<const BinaryExpr&>(expr));
+        case ExprKind::Tenary: break;
+        }
+        return self.visit_tenary(static_cast<const TenaryExpr&>(expr));
+    }
+
+    R visit_postfix_unary(const PostfixUnaryExpr& expr) {
+        return static_cast<Derived&>(*this).visit_unary(expr);
+    }
+};
+}  // namespace pp_expr
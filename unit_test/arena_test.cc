@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include "arena.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <sstream>
+#include <string>
+
+using namespace pp_expr;
+
+TEST(arena, test_allocate_aligned)
+{
+    Arena arena(64);
+    for (int i = 0; i < 100; i++) {
+        auto* c = static_cast<char*>(arena.allocate(1, 1));
+        auto* d = static_cast<double*>(arena.allocate(sizeof(double), alignof(double)));
+        *c = 'x';
+        *d = i;
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(d) % alignof(double), 0u);
+    }
+    EXPECT_GE(arena.bytes_used(), 100 * (1 + sizeof(double)));
+    EXPECT_LT(arena.block_count(), 10u);
+    arena.reset();
+    EXPECT_EQ(arena.block_count(), 0u);
+    EXPECT_EQ(arena.bytes_used(), 0u);
+}
+
+TEST(arena, test_create_runs_destructors)
+{
+    struct Counted {
+        explicit Counted(int* count) : count_(count) {}
+        ~Counted() { ++*count_; }
+        int* count_;
+    };
+    int count = 0;
+    {
+        Arena arena;
+        for (int i = 0; i < 10; i++) {
+            arena.create<Counted>(&count);
+        }
+        EXPECT_EQ(count, 0);
+    }
+    EXPECT_EQ(count, 10);
+}
+
+TEST(arena, test_parse_arena)
+{
+    std::string source = "-+a_very_long_identifier_name_that_is_not_sso = b == 10 ? c > 30 : d[1]--";
+    auto tokens = tokenize(source);
+    auto result = parse_arena(tokens);
+    ASSERT_TRUE(result.root);
+    /// nodes are not reference counted
+    EXPECT_EQ(result.root.use_count(), 0);
+    EXPECT_GT(result.arena->bytes_used(), 0u);
+    EXPECT_EQ(result.arena->block_count(), 1u);
+
+    std::ostringstream ostr;
+    ostr << *result.root;
+    EXPECT_EQ(ostr.str(),
+        "(= (- (+ a_very_long_identifier_name_that_is_not_sso)) (? (== b 10) (> c 30) (([ d 1) --)))");
+
+    /// heap and arena trees print the same
+    Parser parser(tokens);
+    std::ostringstream heap_ostr;
+    heap_ostr << *parser.parse();
+    EXPECT_EQ(heap_ostr.str(), ostr.str());
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "batch_eval.h"
+#include "eval.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace pp_expr;
+
+TEST(batch_eval, test_matches_evaluator)
+{
+    /// not a multiple of chunk size nor vector width
+    const size_t rows = 1003;
+    std::vector<double> a(rows), b(rows), c(rows), d(rows);
+    for (size_t i = 0; i < rows; i++) {
+        a[i] = static_cast<double>(i % 17) - 8;
+        b[i] = static_cast<double>(i % 5) * 0.5;
+        c[i] = static_cast<double>(i % 3);
+        d[i] = static_cast<double>(i % 11) - 2;
+    }
+    Columns columns;
+    columns.bind("a", a.data());
+    columns.bind("b", b.data());
+    columns.bind("c", c.data());
+    columns.bind("d", d.data());
+
+    const char* sources[] = {
+        "a * b + c > d ? a : b",
+        "-a / (b + 1) - c",
+        "a == b || c != 1 && d <= 0",
+        "a >= 0 ? b < 1 ? a : -a : c",
+        "+a",
+        "42",
+        "a - a + 3 * 2",
+    };
+    for (auto* source : sources) {
+        auto ast = parse_str(source);
+        std::vector<double> out(rows);
+        evaluate_batch(*ast, columns, rows, out.data());
+        for (size_t i = 0; i < rows; i++) {
+            Bindings bindings;
+            bindings.set("a", a[i]);
+            bindings.set("b", b[i]);
+            bindings.set("c", c[i]);
+            bindings.set("d", d[i]);
+            ASSERT_EQ(out[i], evaluate(*ast, bindings)) << source << " row " << i;
+        }
+    }
+}
+
+TEST(batch_eval, test_sub_range_and_nan)
+{
+    std::vector<double> x = { 1, NAN, 3, 4, 5 };
+    Columns columns;
+    columns.bind("x", x.data());
+    BatchProgram program(*parse_str("x != x || x == 3"));
+    ASSERT_EQ(program.columns().size(), 1u);
+
+    std::vector<double> out(5, -1);
+    program.run(columns, 1, 4, out.data());
+    EXPECT_EQ(out, (std::vector<double>{ -1, 1, 1, 0, -1 }));
+}
+
+TEST(batch_eval, test_unsupported)
+{
+    EXPECT_THROW(BatchProgram(*parse_str("a = 1")), EvalError);
+    EXPECT_THROW(BatchProgram(*parse_str("a++")), EvalError);
+    EXPECT_THROW(BatchProgram(*parse_str("a[1]")), EvalError);
+    EXPECT_THROW(BatchProgram(*parse_str("*a")), EvalError);
+
+    Columns columns;
+    double out = 0;
+    EXPECT_THROW(evaluate_batch(*parse_str("missing + 1"), columns, 1, &out), EvalError);
+}
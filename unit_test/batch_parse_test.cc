@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "batch_parse.h"
+#include "test_util.h"
+
+#include <string>
+
+using namespace pp_expr;
+
+TEST(batch_parse, test_split)
+{
+    auto pieces = split_expressions("a + b; c\n\n d = 1 ;  \n;e");
+    ASSERT_EQ(pieces.size(), 4u);
+    EXPECT_EQ(pieces[0], "a + b");
+    EXPECT_EQ(pieces[1], " c");
+    EXPECT_EQ(pieces[2], " d = 1 ");
+    EXPECT_EQ(pieces[3], "e");
+    EXPECT_TRUE(split_expressions(" \n ; ").empty());
+}
+
+TEST(batch_parse, test_order_is_stable)
+{
+    std::string buffer;
+    for (int i = 0; i < 5000; i++) {
+        buffer += "x" + std::to_string(i) + " * " + std::to_string(i % 7) + " + y";
+        buffer += i % 3 ? ";" : "\n";
+    }
+    ThreadPool pool(4);
+    auto batch = parse_batch(buffer, pool);
+    ASSERT_EQ(batch.asts.size(), 5000u);
+    EXPECT_LE(batch.arenas.size(), 16u);
+    for (int i = 0; i < 5000; i++) {
+        ASSERT_TRUE(batch.asts[i]);
+        ASSERT_EQ(expr_str(*batch.asts[i]),
+            "(+ (* x" + std::to_string(i) + " " + std::to_string(i % 7) + ") y)");
+    }
+}
+
+TEST(batch_parse, test_matches_parser)
+{
+    std::string buffer = "-+a = b == 10 ? c > 30 : d != 80; *++a++ = i==0 ? 2+3 : 4*5\na ? b ? c : d : e";
+    ThreadPool pool(2);
+    auto batch = parse_batch(buffer, pool);
+    auto pieces = split_expressions(buffer);
+    ASSERT_EQ(batch.asts.size(), pieces.size());
+    for (size_t i = 0; i < pieces.size(); i++) {
+        EXPECT_EQ(expr_str(*batch.asts[i]), expr_str(*parse_str(pieces[i])));
+    }
+    EXPECT_TRUE(parse_batch("", pool).asts.empty());
+}
+
+TEST(batch_parse, test_reports_every_error)
+{
+    std::string buffer = "a + 1\n(b\nc ? d : e; f[1 g\n$; h = 2";
+    ThreadPool pool(2);
+    auto batch = parse_batch(buffer, pool);
+    ASSERT_EQ(batch.asts.size(), 6u);
+    ASSERT_EQ(batch.errors.size(), 6u);
+    EXPECT_EQ(batch.error_count(), 3u);
+    EXPECT_TRUE(batch.asts[0]);
+    EXPECT_EQ(batch.errors[1].code, ParseError::MissingToken);
+    EXPECT_EQ(batch.errors[1].offset(buffer), 8u);
+    EXPECT_TRUE(batch.asts[2]);
+    EXPECT_EQ(batch.errors[3].code, ParseError::MissingToken);
+    EXPECT_EQ(batch.errors[3].got.lexeme(), "g");
+    EXPECT_EQ(batch.errors[4].code, ParseError::InvalidToken);
+    EXPECT_EQ(batch.errors[4].offset(buffer), 26u);
+    EXPECT_FALSE(batch.errors[5]);
+    EXPECT_EQ(expr_str(*batch.asts[5]), "(= h 2)");
+}
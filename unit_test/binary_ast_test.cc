@@ -0,0 +1,241 @@
+#include <gtest/gtest.h>
+
+#include "arena.h"
+#include "binary_ast.h"
+#include "operators.h"
+#include "precedence.h"
+#include "serialize.h"
+#include "test_util.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace pp_expr;
+
+static const char* kSources[] = {
+    "-+a = b == 10 ? c > 30 : d != 80",
+    "*++a++ = i==0 ? 2+3 : 4*5",
+    "a ? b ? c : d : e",
+    "-a[10][1] + b--",
+    "x",
+    "0.1 + 1e300 * a - a / 0.1",
+};
+
+static std::string encode_all()
+{
+    BinaryAstWriter writer;
+    for (auto* source : kSources) {
+        writer.add(*parse_str(source));
+    }
+    return writer.finish();
+}
+
+TEST(binary_ast, test_round_trip)
+{
+    std::string bytes = encode_all();
+    BinaryAstView view;
+    std::string error;
+    ASSERT_TRUE(view.open(bytes.data(), bytes.size(), &error)) << error;
+    ASSERT_EQ(view.size(), std::size(kSources));
+    for (size_t i = 0; i < view.size(); i++) {
+        auto ast = decode_ast(view, i);
+        EXPECT_EQ(to_sexpr(*ast), to_sexpr(*parse_str(kSources[i]))) << kSources[i];
+    }
+
+    Arena arena;
+    ArenaBuilder builder(arena);
+    auto ast = decode_ast(view, 1, builder);
+    EXPECT_EQ(to_sexpr(*ast), "(= (* (++ (a ++))) (? (== i 0) (+ 2 3) (* 4 5)))");
+}
+
+TEST(binary_ast, test_rejects_user_operators)
+{
+    OperatorRegistry registry;
+    registry.add_infix("**", PREC_MULTIPLICATIVE + 5, Assoc::Right);
+    auto ops = registry.freeze();
+    auto user = parse_str("new + (1.5 - 2) ** b", *ops);
+
+    BinaryAstWriter writer, expected;
+    writer.add(*parse_str("a - 1"));
+    EXPECT_THROW(writer.add(*user), std::invalid_argument);
+    EXPECT_EQ(writer.size(), 1u);
+
+    /// nothing of the rejected expression is left in the file, and later
+    /// expressions get the literals it had added again
+    writer.add(*parse_str("new * 1.5"));
+    expected.add(*parse_str("a - 1"));
+    expected.add(*parse_str("new * 1.5"));
+    std::string bytes = writer.finish();
+    EXPECT_EQ(bytes, expected.finish());
+    BinaryAstView view;
+    std::string error;
+    ASSERT_TRUE(view.open(bytes.data(), bytes.size(), &error)) << error;
+    ASSERT_EQ(view.size(), 2u);
+    EXPECT_EQ(to_sexpr(*decode_ast(view, 0)), "(- a 1)");
+    EXPECT_EQ(to_sexpr(*decode_ast(view, 1)), "(* new 1.5)");
+}
+
+TEST(binary_ast, test_read_in_place)
+{
+    BinaryAstWriter writer;
+    writer.add(*parse_str("a + a * 2"));
+    writer.add(*parse_str("b[2] ? a : -b"));
+    std::string bytes = writer.finish();
+    BinaryAstView view;
+    ASSERT_TRUE(view.open(bytes.data(), bytes.size()));
+
+    auto header = reinterpret_cast<const BinaryAstHeader*>(bytes.data());
+    EXPECT_EQ(header->ident_count, 2u);
+    EXPECT_EQ(header->number_count, 1u);
+
+    uint32_t root = view.root(0);
+    EXPECT_EQ(view.begin(0), 0u);
+    EXPECT_EQ(view.kind(root), ExprKind::Binary);
+    EXPECT_EQ(view.op(root), TOK_PLUS);
+    EXPECT_EQ(view.ident(view.child(root, 0)), "a");
+    uint32_t mul = view.child(root, 1);
+    EXPECT_EQ(view.op(mul), TOK_STAR);
+    EXPECT_EQ(view.number(view.child(mul, 1)), 2.0);
+
+    root = view.root(1);
+    EXPECT_EQ(view.begin(1), view.root(0) + 1);
+    EXPECT_EQ(view.kind(root), ExprKind::Tenary);
+    uint32_t neg = view.child(root, 2);
+    EXPECT_EQ(view.kind(neg), ExprKind::Unary);
+    EXPECT_EQ(view.ident(view.child(neg, 0)), "b");
+}
+
+TEST(binary_ast, test_position_independent)
+{
+    std::string bytes = encode_all();
+    /// same bytes at another address read the same
+    std::vector<double> copy(bytes.size() / sizeof(double) + 1);
+    std::memcpy(copy.data(), bytes.data(), bytes.size());
+    BinaryAstView view;
+    ASSERT_TRUE(view.open(copy.data(), bytes.size()));
+    EXPECT_EQ(to_sexpr(*decode_ast(view, 3)), "(+ (- ([ ([ a 10) 1)) (b --))");
+}
+
+TEST(binary_ast, test_mapped_file)
+{
+    std::string bytes = encode_all();
+    char path[] = "/tmp/binary_ast_test_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, bytes.data(), bytes.size()), static_cast<ssize_t>(bytes.size()));
+    close(fd);
+
+    MappedFile file;
+    std::string error;
+    ASSERT_TRUE(file.open(path, &error)) << error;
+    BinaryAstView view;
+    ASSERT_TRUE(view.open(file.data(), file.size(), &error)) << error;
+    for (size_t i = 0; i < view.size(); i++) {
+        EXPECT_EQ(to_sexpr(*decode_ast(view, i)), to_sexpr(*parse_str(kSources[i])));
+    }
+    unlink(path);
+
+    MappedFile missing;
+    EXPECT_FALSE(missing.open(path, &error));
+    EXPECT_NE(error.find(path), std::string::npos);
+}
+
+TEST(binary_ast, test_deep_tree)
+{
+    std::string source;
+    for (int i = 0; i < 50000; i++) {
+        source += "- ";
+    }
+    source += "a";
+    auto ast = parse_str(source);
+    ASSERT_TRUE(ast);
+
+    BinaryAstWriter writer;
+    writer.add(*ast);
+    std::string bytes = writer.finish();
+    BinaryAstView view;
+    ASSERT_TRUE(view.open(bytes.data(), bytes.size()));
+    auto back = decode_ast(view, 0);
+    const Expr* node = back.get();
+    int depth = 0;
+    while (node->kind() == ExprKind::Unary) {
+        node = static_cast<const UnaryExpr*>(node)->operand().get();
+        depth++;
+    }
+    EXPECT_EQ(depth, 50000);
+}
+
+TEST(binary_ast, test_rejects_bad_data)
+{
+    std::string good = encode_all();
+    auto header = [](std::string& bytes) {
+        return reinterpret_cast<BinaryAstHeader*>(&bytes[0]);
+    };
+    auto rejects = [](const std::string& bytes, const std::string& expected) {
+        BinaryAstView view;
+        std::string error;
+        EXPECT_FALSE(view.open(bytes.data(), bytes.size(), &error));
+        EXPECT_EQ(error, expected);
+        EXPECT_EQ(view.size(), 0u);
+    };
+
+    rejects(good.substr(0, 10), "truncated header");
+    rejects(good.substr(0, good.size() - 8), "truncated data");
+
+    std::string bytes = good;
+    header(bytes)->magic = 0;
+    rejects(bytes, "bad magic");
+
+    bytes = good;
+    header(bytes)->version = kBinaryAstVersion + 1;
+    rejects(bytes, "unsupported version");
+
+    bytes = good;
+    header(bytes)->node_count = 1u << 30;
+    rejects(bytes, "section out of bounds");
+
+    /// first expression's root pointing at itself
+    bytes = good;
+    auto* nodes = reinterpret_cast<BinaryAstNode*>(&bytes[header(bytes)->nodes_offset]);
+    auto* children = reinterpret_cast<uint32_t*>(&bytes[header(bytes)->children_offset]);
+    uint32_t root = reinterpret_cast<uint32_t*>(&bytes[header(bytes)->roots_offset])[0];
+    children[nodes[root].arg] = root;
+    rejects(bytes, "child does not precede its parent");
+
+    bytes = good;
+    nodes = reinterpret_cast<BinaryAstNode*>(&bytes[header(bytes)->nodes_offset]);
+    nodes[root].op = TOK_INVALID;
+    rejects(bytes, "bad operator");
+    /// tokens that are no operator, or not one of a binary node
+    for (TokenType op : { TOK_RPAREN, TOK_SEMI, TOK_COLON, TOK_QUESTION, TOK_INC }) {
+        nodes[root].op = op;
+        rejects(bytes, "bad operator");
+    }
+
+    bytes = good;
+    nodes = reinterpret_cast<BinaryAstNode*>(&bytes[header(bytes)->nodes_offset]);
+    nodes[0].arg = 1000;
+    rejects(bytes, "bad identifier node");
+}
+
+TEST(binary_ast, test_shared_children)
+{
+    BinaryAstWriter writer;
+    writer.add(*parse_str("a * b + 1"));
+    std::string bytes = writer.finish();
+    auto* header = reinterpret_cast<BinaryAstHeader*>(&bytes[0]);
+    auto* nodes = reinterpret_cast<BinaryAstNode*>(&bytes[header->nodes_offset]);
+    auto* children = reinterpret_cast<uint32_t*>(&bytes[header->children_offset]);
+    uint32_t root = reinterpret_cast<uint32_t*>(&bytes[header->roots_offset])[0];
+    /// both operands of + are the same node
+    children[nodes[root].arg + 1] = children[nodes[root].arg];
+
+    BinaryAstView view;
+    std::string error;
+    ASSERT_TRUE(view.open(bytes.data(), bytes.size(), &error)) << error;
+    EXPECT_EQ(to_sexpr(*decode_ast(view, 0)), "(+ (* a b) (* a b))");
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include "bytecode.h"
+#include "eval.h"
+#include "test_util.h"
+
+#include <string>
+#include <thread>
+
+using namespace pp_expr;
+
+static Program compile_str(const std::string& source)
+{
+    return compile(*parse_str(source));
+}
+
+static double run_str(const std::string& source, Bindings& bindings)
+{
+    auto program = compile_str(source);
+    Vm vm;
+    vm.bind(program, bindings);
+    return vm.run(program);
+}
+
+TEST(bytecode, test_matches_evaluator)
+{
+    const char* sources[] = {
+        "3 + 4 - 5 - 6",
+        "3 + (4 - 5) * 6 / 4",
+        "-+-a",
+        "a < b && b < 10",
+        "a > b || b == 4",
+        "a - 3 ? 10 : b ? 30 : 40",
+        "v[0] + v[a - 1] * 2",
+        "a == 3 && (b = 7) || b",
+        "(a = b = 5) + a",
+        /// x is unbound until written, e is empty
+        "c ? (x = 1) : x",
+        "c - 1 ? (x = 1) : x",
+        "(x = 2) + x++ + x",
+        "e + 1",
+        "e[0]",
+        "(e = 4) + e",
+    };
+    for (auto* source : sources) {
+        Bindings tree_bindings;
+        tree_bindings.set("a", 3);
+        tree_bindings.set("b", 4);
+        tree_bindings.set("c", 0);
+        tree_bindings.set("v", std::vector<double>{ 10, 20, 30 });
+        /// cleared, but its buffer is still allocated
+        tree_bindings.set("e", std::vector<double>{ 1, 2 });
+        tree_bindings.find("e")->clear();
+        Bindings vm_bindings = tree_bindings;
+        vm_bindings.find("e")->reserve(2);
+
+        auto ast = parse_str(source);
+        auto program = compile(*ast);
+        Vm vm;
+        vm.bind(program, vm_bindings);
+        EXPECT_EQ(vm_bindings.size(), tree_bindings.size()) << source;
+        try {
+            double expected = evaluate(*ast, tree_bindings);
+            EXPECT_EQ(vm.run(program), expected) << source;
+        } catch (const EvalError& e) {
+            EXPECT_THROW(vm.run(program), EvalError) << source << ": " << e.what();
+        }
+        EXPECT_EQ(vm_bindings.size(), tree_bindings.size()) << source;
+        for (auto* name : { "a", "b", "e", "x" }) {
+            auto* values = tree_bindings.find(name);
+            if (values) {
+                ASSERT_NE(vm_bindings.find(name), nullptr) << source;
+                EXPECT_EQ(*vm_bindings.find(name), *values) << source;
+            }
+        }
+    }
+}
+
+TEST(bytecode, test_short_circuit_jumps)
+{
+    auto program = compile_str("a && b");
+    /// load a, bool, jump_if_false_or_pop, load b, bool, return
+    ASSERT_EQ(program.code.size(), 6u);
+    EXPECT_EQ(program.code[2].op, OP_JUMP_IF_FALSE_OR_POP);
+    EXPECT_EQ(program.code[2].arg, 5u);
+
+    Bindings bindings;
+    bindings.set("a", 0);
+    /// b is unbound but never loaded
+    EXPECT_EQ(run_str("a && b", bindings), 0);
+    EXPECT_EQ(run_str("a || 1", bindings), 1);
+    EXPECT_THROW(run_str("a || b", bindings), EvalError);
+}
+
+TEST(bytecode, test_increment_slots)
+{
+    Bindings bindings;
+    bindings.set("v", std::vector<double>{ 1, 2, 3 });
+    EXPECT_EQ(run_str("i++ + ++i", bindings), 2);
+    EXPECT_EQ(*bindings.find("i"), std::vector<double>{ 2 });
+    EXPECT_EQ(run_str("v[1]++ + --v[2]", bindings), 4);
+    EXPECT_EQ(*bindings.find("v"), (std::vector<double>{ 1, 3, 2 }));
+    EXPECT_EQ(run_str("v[i] = 9", bindings), 9);
+    EXPECT_EQ((*bindings.find("v"))[2], 9);
+    EXPECT_THROW(run_str("v[3]", bindings), EvalError);
+    EXPECT_THROW(compile_str("3 = 4"), EvalError);
+    EXPECT_THROW(compile_str("*a"), EvalError);
+}
+
+TEST(bytecode, test_shared_program_across_threads)
+{
+    auto program = compile_str("x * x + 1 > 10 ? x : -x");
+    std::vector<double> results(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < results.size(); t++) {
+        threads.emplace_back([&program, &results, t] {
+            Bindings bindings;
+            bindings.set("x", 0);
+            Vm vm;
+            vm.bind(program, bindings);
+            double* x = vm.slot_data(program.slot_of("x"));
+            double sum = 0;
+            for (int i = 0; i < 1000; i++) {
+                *x = i + static_cast<double>(t);
+                sum += vm.run(program);
+            }
+            results[t] = sum;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t t = 0; t < results.size(); t++) {
+        double expected = 0;
+        for (int i = 0; i < 1000; i++) {
+            double x = i + static_cast<double>(t);
+            expected += x * x + 1 > 10 ? x : -x;
+        }
+        EXPECT_EQ(results[t], expected);
+    }
+}
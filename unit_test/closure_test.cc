@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include "closure.h"
+#include "eval.h"
+#include "test_util.h"
+
+#include <string>
+
+using namespace pp_expr;
+
+static ClosureProgram lower_str(const std::string& source, Bindings& bindings)
+{
+    return ClosureProgram(*parse_str(source), bindings);
+}
+
+static double run_str(const std::string& source, Bindings& bindings)
+{
+    return lower_str(source, bindings).run();
+}
+
+TEST(closure, test_matches_evaluator)
+{
+    const char* sources[] = {
+        "3 + 4 - 5 - 6",
+        "3 + (4 - 5) * 6 / 4",
+        "-+-a",
+        "a",
+        "7",
+        "a < b && b < 10",
+        "a > b || b == 4",
+        "a - 3 ? 10 : b ? 30 : 40",
+        "1 ? a : b",
+        "v[0] + v[a - 1] * 2",
+        "a == 3 && (b = 7) || b",
+        "(a = b = 5) + a",
+        "a++ + ++b - --a * b--",
+        "v[1]++ + --v[2] + (v[0] = a)",
+        "a <= b != (b >= a) == 0 / 1",
+        /// x and w are unbound until written
+        "c ? (x = 1) : x",
+        "c - 1 ? (x = 1) : x",
+        "(x = 2) + x++ + x",
+        "++x[0]",
+        "(w = 3) + w[0] + (w[0] = 4) + --w[0] + w[x = 0]",
+    };
+    for (auto* source : sources) {
+        Bindings tree_bindings;
+        tree_bindings.set("a", 3);
+        tree_bindings.set("b", 4);
+        tree_bindings.set("c", 0);
+        tree_bindings.set("v", std::vector<double>{ 10, 20, 30 });
+        Bindings closure_bindings = tree_bindings;
+
+        auto ast = parse_str(source);
+        auto program = ClosureProgram(*ast, closure_bindings);
+        EXPECT_EQ(closure_bindings.size(), tree_bindings.size()) << source;
+        try {
+            double expected = evaluate(*ast, tree_bindings);
+            EXPECT_EQ(program.run(), expected) << source;
+        } catch (const EvalError& e) {
+            EXPECT_THROW(program.run(), EvalError) << source << ": " << e.what();
+        }
+        EXPECT_EQ(closure_bindings.size(), tree_bindings.size()) << source;
+        for (auto* name : { "a", "b", "v", "x", "w" }) {
+            auto* values = tree_bindings.find(name);
+            if (values) {
+                ASSERT_NE(closure_bindings.find(name), nullptr) << source;
+                EXPECT_EQ(*closure_bindings.find(name), *values) << source;
+            }
+        }
+    }
+}
+
+TEST(closure, test_folds_constants)
+{
+    Bindings bindings;
+    bindings.set("x", 2);
+    EXPECT_EQ(lower_str("1 + 2 * 3", bindings).size(), 1u);
+    EXPECT_EQ(lower_str("x * (4 - -1)", bindings).size(), 1u);
+    EXPECT_EQ(lower_str("0 ? x : x + 1", bindings).size(), 1u);
+    EXPECT_EQ(lower_str("x * x + 1", bindings).size(), 2u);
+    EXPECT_EQ(run_str("x * (4 - -1)", bindings), 10);
+}
+
+TEST(closure, test_reads_variables_on_each_run)
+{
+    Bindings bindings;
+    bindings.set("x", 0);
+    auto program = lower_str("x * x + 1 > 10 ? x : -x", bindings);
+    double* x = bindings.find("x")->data();
+    for (int i = 0; i < 10; i++) {
+        *x = i;
+        EXPECT_EQ(program.run(), i * i + 1 > 10 ? i : -i);
+    }
+    /// nodes keep pointing at each other after a move
+    ClosureProgram moved = std::move(program);
+    *x = 5;
+    EXPECT_EQ(moved.run(), 5);
+}
+
+TEST(closure, test_errors)
+{
+    Bindings bindings;
+    bindings.set("a", 0);
+    bindings.set("v", std::vector<double>{ 1, 2 });
+    /// unbound variables fail only if they are read
+    EXPECT_EQ(run_str("a && b", bindings), 0);
+    EXPECT_THROW(run_str("a || b", bindings), EvalError);
+    EXPECT_THROW(run_str("w[0]", bindings), EvalError);
+    EXPECT_THROW(run_str("v[2]", bindings), EvalError);
+    EXPECT_THROW(run_str("v[0.5] = 1", bindings), EvalError);
+    EXPECT_THROW(lower_str("3 = 4", bindings), EvalError);
+    EXPECT_THROW(lower_str("*a", bindings), EvalError);
+    EXPECT_THROW(lower_str("1[0]", bindings), EvalError);
+    /// written variables are created
+    EXPECT_EQ(run_str("c = 4", bindings), 4);
+    EXPECT_EQ(*bindings.find("c"), std::vector<double>{ 4 });
+}
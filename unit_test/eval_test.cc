@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include "eval.h"
+#include "hash_cons.h"
+#include "test_util.h"
+#include "visitor.h"
+
+#include <string>
+
+using namespace pp_expr;
+
+static double eval_str(const std::string& source, Bindings& bindings)
+{
+    return evaluate(*parse_str(source), bindings);
+}
+
+TEST(eval, test_arithmetic)
+{
+    Bindings bindings;
+    EXPECT_EQ(eval_str("3 + 4 - 5 - 6", bindings), -4);
+    EXPECT_EQ(eval_str("3 + (4 - 5) * 6", bindings), -3);
+    EXPECT_EQ(eval_str("-+-2", bindings), 2);
+    EXPECT_EQ(eval_str("7 / 2", bindings), 3.5);
+}
+
+TEST(eval, test_comparison_logical)
+{
+    Bindings bindings;
+    bindings.set("a", 3);
+    bindings.set("b", 4);
+    EXPECT_EQ(eval_str("a < b", bindings), 1);
+    EXPECT_EQ(eval_str("a >= b", bindings), 0);
+    EXPECT_EQ(eval_str("a == 3 && b != 3", bindings), 1);
+    EXPECT_EQ(eval_str("a == 4 || b == 3", bindings), 0);
+    EXPECT_EQ(eval_str("a ? 10 : 20", bindings), 10);
+    EXPECT_EQ(eval_str("a - 3 ? 10 : b ? 30 : 40", bindings), 30);
+}
+
+TEST(eval, test_short_circuit)
+{
+    Bindings bindings;
+    bindings.set("x", 0);
+    EXPECT_EQ(eval_str("0 && (x = 1)", bindings), 0);
+    EXPECT_EQ(eval_str("x", bindings), 0);
+    EXPECT_EQ(eval_str("1 || (x = 1)", bindings), 1);
+    EXPECT_EQ(eval_str("x", bindings), 0);
+    /// unbound name is never reached
+    EXPECT_EQ(eval_str("1 ? 5 : nowhere", bindings), 5);
+}
+
+TEST(eval, test_assignment_increment)
+{
+    Bindings bindings;
+    EXPECT_EQ(eval_str("a = b = 5", bindings), 5);
+    EXPECT_EQ(eval_str("a", bindings), 5);
+    EXPECT_EQ(eval_str("b", bindings), 5);
+    EXPECT_EQ(eval_str("a++", bindings), 5);
+    EXPECT_EQ(eval_str("a", bindings), 6);
+    EXPECT_EQ(eval_str("++a", bindings), 7);
+    EXPECT_EQ(eval_str("--a + a--", bindings), 12);
+    EXPECT_EQ(eval_str("a", bindings), 5);
+}
+
+TEST(eval, test_indexing)
+{
+    Bindings bindings;
+    bindings.set("v", std::vector<double>{ 10, 20, 30 });
+    bindings.set("i", 1);
+    EXPECT_EQ(eval_str("v[0] + v[i + 1]", bindings), 40);
+    EXPECT_EQ(eval_str("v[i] = 5", bindings), 5);
+    EXPECT_EQ(eval_str("v[1]++ + v[1]", bindings), 11);
+    EXPECT_EQ((*bindings.find("v"))[1], 6);
+}
+
+TEST(eval, test_errors)
+{
+    Bindings bindings;
+    bindings.set("v", std::vector<double>{ 1, 2 });
+    EXPECT_THROW(eval_str("unknown + 1", bindings), EvalError);
+    EXPECT_THROW(eval_str("v[2]", bindings), EvalError);
+    EXPECT_THROW(eval_str("v[-1]", bindings), EvalError);
+    EXPECT_THROW(eval_str("v[0.5]", bindings), EvalError);
+    EXPECT_THROW(eval_str("3 = 4", bindings), EvalError);
+    EXPECT_THROW(eval_str("*v", bindings), EvalError);
+    EXPECT_THROW(eval_str("&v", bindings), EvalError);
+}
+
+TEST(eval, test_resolved_bindings)
+{
+    SymbolTable symbols;
+    SymbolBuilder builder(symbols);
+    auto parse = [&](const std::string& source) { return parse_str(source, builder); };
+    auto sum = parse("a + v[1] * 2");
+    auto assign = parse("c = a++");
+
+    Bindings bindings;
+    bindings.set("a", 3);
+    bindings.set("v", { 1, 2, 3 });
+    ResolvedBindings slots(symbols, bindings);
+    EXPECT_EQ(evaluate(*sum, slots), 7);
+    /// slots see later writes through Bindings
+    bindings.set("a", 5);
+    EXPECT_EQ(evaluate(*sum, slots), 9);
+
+    /// c is created on assignment and bound to its slot from then on
+    EXPECT_EQ(evaluate(*assign, slots), 5);
+    EXPECT_EQ((*bindings.find("c"))[0], 5);
+    EXPECT_EQ((*bindings.find("a"))[0], 6);
+    EXPECT_EQ(evaluate(*parse("c + 1"), slots), 6);
+
+    /// symbols interned after resolution and trees without ids still work
+    bindings.set("late", 10);
+    EXPECT_EQ(evaluate(*parse("late * 2"), slots), 20);
+    EXPECT_EQ(eval_str("late + a", bindings), 16);
+    EXPECT_EQ(evaluate(*parse_str("late - 1"), slots), 9);
+
+    EXPECT_THROW(evaluate(*parse("missing"), slots), EvalError);
+}
+
+TEST(eval, test_resolved_tables_share_hash_cons)
+{
+    /// the same names interned in two tables get different ids
+    HashConsBuilder hash_cons;
+    SymbolTable first, second;
+    SymbolBuilder first_builder(first, hash_cons), second_builder(second, hash_cons);
+    auto sum = parse_str("x + y", first_builder);
+    auto y = parse_str("y", second_builder);
+    EXPECT_EQ(expr_cast<Ident>(*y).id(), 0u);
+    EXPECT_NE(expr_cast<BinaryExpr>(*sum).right().get(), y.get());
+
+    Bindings bindings;
+    bindings.set("x", 1);
+    bindings.set("y", 100);
+    ResolvedBindings first_slots(first, bindings), second_slots(second, bindings);
+    EXPECT_EQ(evaluate(*sum, first_slots), 101);
+    EXPECT_EQ(evaluate(*y, second_slots), 100);
+    /// ids of another table fall back to the name
+    EXPECT_EQ(evaluate(*sum, second_slots), 101);
+    EXPECT_EQ(evaluate(*y, first_slots), 100);
+}
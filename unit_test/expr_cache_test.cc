@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include "eval.h"
+#include "expr_cache.h"
+#include "test_util.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pp_expr;
+
+TEST(expr_cache, test_hit_miss)
+{
+    ExprCache cache(1 << 20);
+    auto a = cache.get("x * (1 + 2)");
+    ASSERT_TRUE(a);
+    /// cached form is optimized
+    EXPECT_EQ(expr_str(*a->ast), "(* x 3)");
+
+    auto b = cache.get("x * (1 + 2)");
+    EXPECT_EQ(a, b);
+    cache.get("y");
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.entries, 2u);
+    EXPECT_GT(stats.bytes, 0u);
+
+    EXPECT_FALSE(cache.get("   "));
+}
+
+TEST(expr_cache, test_long_source)
+{
+    /// a flat chain is as deep as it is long once parsed
+    std::string source = "a";
+    for (int i = 1; i < 200000; i++) {
+        source += "+a";
+    }
+    ExprCache cache(1 << 20);
+    auto entry = cache.get(source);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry->ast->kind(), ExprKind::Binary);
+}
+
+TEST(expr_cache, test_lru_eviction)
+{
+    size_t entry_bytes = compile_cached("a0 + 1")->bytes();
+    /// one shard holding about three entries
+    ExprCache cache(entry_bytes * 3 + entry_bytes / 2, 1);
+    auto first = cache.get("a0 + 1");
+    cache.get("a1 + 1");
+    cache.get("a2 + 1");
+    /// touch a0, so a1 is least recently used
+    cache.get("a0 + 1");
+    cache.get("a3 + 1");
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_EQ(stats.entries, 3u);
+    EXPECT_LE(stats.bytes, entry_bytes * 3 + entry_bytes / 2);
+
+    size_t misses = cache.stats().misses;
+    cache.get("a0 + 1");
+    EXPECT_EQ(cache.stats().misses, misses);
+    cache.get("a1 + 1");
+    EXPECT_EQ(cache.stats().misses, misses + 1);
+
+    /// evicted entries stay valid for their holders
+    cache.clear();
+    Bindings bindings;
+    bindings.set("a0", 2);
+    EXPECT_EQ(evaluate(*first->ast, bindings), 3);
+}
+
+TEST(expr_cache, test_concurrent_get)
+{
+    ExprCache cache(1 << 16, 4);
+    std::vector<std::thread> threads;
+    std::vector<double> sums(4, 0);
+    for (size_t t = 0; t < sums.size(); t++) {
+        threads.emplace_back([&cache, &sums, t] {
+            Bindings bindings;
+            bindings.set("x", 2);
+            for (int i = 0; i < 2000; i++) {
+                auto entry = cache.get("x * " + std::to_string(i % 50));
+                sums[t] += evaluate(*entry->ast, bindings);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto sum : sums) {
+        EXPECT_EQ(sum, 2 * 40 * (49 * 50 / 2));
+    }
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits + stats.misses, 8000u);
+    EXPECT_LE(stats.entries, 50u);
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include "flat_ast.h"
+#include "lexer.h"
+#include "parser.h"
+#include "test_util.h"
+
+#include <sstream>
+#include <string>
+
+using namespace pp_expr;
+
+static std::string flat_str(const std::string& source)
+{
+    FlatAst ast;
+    parse_flat(tokenize(source), ast);
+    std::ostringstream ostr;
+    ostr << ast;
+    return ostr.str();
+}
+
+TEST(flat_ast, test_post_order_layout)
+{
+    /// 3 + x * 2
+    FlatAst ast;
+    parse_flat(tokenize("3 + x * 2"), ast);
+    ASSERT_EQ(ast.size(), 5u);
+    std::vector<ExprKind> kinds = {
+        ExprKind::Number, ExprKind::Ident, ExprKind::Number, ExprKind::Binary, ExprKind::Binary,
+    };
+    EXPECT_EQ(ast.kinds, kinds);
+    EXPECT_EQ(ast.ops[3], TOK_STAR);
+    EXPECT_EQ(ast.ops[4], TOK_PLUS);
+    EXPECT_EQ(ast.root(), 4u);
+    EXPECT_EQ(ast.child(4, 0), 0u);
+    EXPECT_EQ(ast.child(4, 1), 3u);
+    EXPECT_EQ(ast.child(3, 0), 1u);
+    EXPECT_EQ(ast.child(3, 1), 2u);
+    EXPECT_EQ(ast.number(0), 3);
+    EXPECT_EQ(ast.ident(1), "x");
+    EXPECT_EQ(ast.number(2), 2);
+    /// every child precedes its parent
+    for (uint32_t i = 0; i < ast.size(); i++) {
+        for (uint32_t c = 0; c < child_count(ast.kinds[i]); c++) {
+            EXPECT_LT(ast.child(i, c), i);
+        }
+    }
+}
+
+TEST(flat_ast, test_print_matches_tree)
+{
+    const char* sources[] = {
+        "-a",
+        "3 + (4 - 5) - 6",
+        "-+*&++---a+b",
+        "-+a = b == 10 ? c > 30 : d != 80",
+        "*++a++ = i==0 ? 2+3 : 4*5",
+        "a ? b ? c : d : e",
+        "-a[10][1]+b",
+        "-a[10]--",
+    };
+    for (auto* source : sources) {
+        EXPECT_EQ(flat_str(source), expr_str(*parse_str(source))) << source;
+    }
+}
+
+TEST(flat_ast, test_reuse)
+{
+    FlatAst ast;
+    parse_flat(tokenize("a + b + c"), ast);
+    EXPECT_EQ(ast.size(), 5u);
+    parse_flat(tokenize("x"), ast);
+    EXPECT_EQ(ast.size(), 1u);
+    EXPECT_EQ(ast.idents.size(), 1u);
+    EXPECT_TRUE(ast.children.empty());
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include "hash_cons.h"
+#include "optimize.h"
+#include "test_util.h"
+
+#include <string>
+
+using namespace pp_expr;
+
+TEST(hash_cons, test_shared_subtrees)
+{
+    HashConsBuilder builder;
+    auto a = parse_str("(x + y * 2) > 3 ? x + y * 2 : z", builder);
+    auto b = parse_str("w - (x + y * 2)", builder);
+
+    auto& tenary = static_cast<const TenaryExpr&>(*a);
+    auto& cond = static_cast<const BinaryExpr&>(*tenary.operand1());
+    auto& minus = static_cast<const BinaryExpr&>(*b);
+    /// identical subexpressions are the same node, within and across parses
+    EXPECT_EQ(cond.left(), tenary.operand2());
+    EXPECT_EQ(cond.left(), minus.right());
+
+    /// x y 2 (* y 2) (+ x ..) 3 (> ..) z (? ..) w (- w ..)
+    EXPECT_EQ(builder.size(), 11u);
+    EXPECT_GT(builder.hits(), 0u);
+
+    EXPECT_EQ(expr_str(*a), "(? (> (+ x (* y 2)) 3) (+ x (* y 2)) z)");
+}
+
+TEST(hash_cons, test_distinguishes_structure)
+{
+    HashConsBuilder builder;
+    auto a = parse_str("a - b", builder);
+    auto b = parse_str("b - a", builder);
+    auto c = parse_str("a + b", builder);
+    auto d = parse_str("-a", builder);
+    auto e = parse_str("a--", builder);
+    EXPECT_NE(a, b);
+    EXPECT_NE(a, c);
+    EXPECT_NE(d, e);
+    EXPECT_EQ(parse_str("a - b", builder), a);
+    EXPECT_NE(builder.number(0.0), builder.number(-0.0));
+}
+
+TEST(hash_cons, test_optimize_through_interning)
+{
+    HashConsBuilder builder;
+    auto folded = optimize(parse_str("x * (1 + 2)", builder), builder);
+    EXPECT_EQ(folded, parse_str("x * 3", builder));
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "parser.h"
+
+#include <sstream>
+#include <string>
+
+using namespace pp_expr;
+
+TEST(lexer, test_operators)
+{
+    std::string source = "+ ++ - -- * / & && = == != < <= > >= || ? : ( ) [ ] ;";
+    auto tokens = tokenize(source);
+    std::vector<TokenType> expected = {
+        TOK_PLUS, TOK_INC, TOK_MINUS, TOK_DEC, TOK_STAR, TOK_SLASH,
+        TOK_AMPERSAND, TOK_AND, TOK_ASSIGN, TOK_EQ, TOK_NE, TOK_LT, TOK_LE,
+        TOK_GT, TOK_GE, TOK_OR, TOK_QUESTION, TOK_COLON, TOK_LPAREN,
+        TOK_RPAREN, TOK_LSQUAR, TOK_RSQUAR, TOK_SEMI,
+    };
+    ASSERT_EQ(tokens.size(), expected.size());
+    for (size_t i = 0; i < tokens.size(); i++) {
+        EXPECT_EQ(tokens[i].token_type, expected[i]);
+        EXPECT_EQ(tokens[i].lexeme(), Lexeme(expected[i]));
+    }
+}
+
+TEST(lexer, test_longest_match)
+{
+    /// a+++b => a ++ + b
+    auto tokens = tokenize("a+++b<=c&&&d");
+    std::vector<TokenType> expected = {
+        TOK_ID, TOK_INC, TOK_PLUS, TOK_ID, TOK_LE, TOK_ID, TOK_AND, TOK_AMPERSAND, TOK_ID,
+    };
+    ASSERT_EQ(tokens.size(), expected.size());
+    for (size_t i = 0; i < tokens.size(); i++) {
+        EXPECT_EQ(tokens[i].token_type, expected[i]);
+    }
+}
+
+TEST(lexer, test_literals_reference_source)
+{
+    std::string source = "  foo_1 12.5e3 .5 7 bar";
+    auto tokens = tokenize(source);
+    ASSERT_EQ(tokens.size(), 5u);
+    EXPECT_EQ(tokens[0].token_type, TOK_ID);
+    EXPECT_EQ(tokens[0].lexeme(), "foo_1");
+    EXPECT_EQ(tokens[1].token_type, TOK_NUM);
+    EXPECT_EQ(tokens[1].lexeme(), "12.5e3");
+    EXPECT_EQ(tokens[2].lexeme(), ".5");
+    EXPECT_EQ(tokens[3].lexeme(), "7");
+    EXPECT_EQ(tokens[4].lexeme(), "bar");
+    /// lexemes are views into source, not copies
+    EXPECT_EQ(tokens[0].lexeme().data(), source.data() + 2);
+    EXPECT_EQ(tokens[4].offset(source), 20u);
+}
+
+TEST(lexer, test_invalid_char)
+{
+    auto tokens = tokenize("a ! b | c $");
+    ASSERT_EQ(tokens.size(), 6u);
+    EXPECT_EQ(tokens[1].token_type, TOK_INVALID);
+    EXPECT_EQ(tokens[1].lexeme(), "!");
+    EXPECT_EQ(tokens[3].token_type, TOK_INVALID);
+    EXPECT_EQ(tokens[5].token_type, TOK_INVALID);
+}
+
+TEST(lexer, test_parse_source)
+{
+    std::string source = "*++a++ = i==0 ? 2+3.5 : 4*5";
+    auto tokens = tokenize(source);
+    Parser parser(tokens);
+    auto ast = parser.parse();
+    /// tree doesn't refer to source text after parsing
+    source.assign(source.size(), ' ');
+    std::ostringstream ostr;
+    ostr << *ast;
+    EXPECT_EQ(ostr.str(), "(= (* (++ (a ++))) (? (== i 0) (+ 2 3.5) (* 4 5)))");
+}
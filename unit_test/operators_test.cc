@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include "eval.h"
+#include "lexer.h"
+#include "operators.h"
+#include "parser.h"
+#include "precedence.h"
+#include "serialize.h"
+#include "stream_parser.h"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pp_expr;
+
+static std::shared_ptr<const OperatorTable> make_operators()
+{
+    OperatorRegistry registry;
+    registry.add_infix("**", PREC_MULTIPLICATIVE + 5, Assoc::Right);
+    registry.add_infix("%", PREC_MULTIPLICATIVE);
+    registry.add_infix("<<", PREC_ADDITIVE - 5);
+    registry.add_infix("in", PREC_RELATIONAL);
+    registry.add_prefix("!", PREC_UNARY);
+    registry.add_postfix("!", PREC_POSTFIX);
+    return registry.freeze();
+}
+
+static std::string parse_str(const std::string& source, const OperatorTable& ops)
+{
+    auto tokens = tokenize(source, ops);
+    Parser parser(tokens);
+    parser.set_operators(ops);
+    auto result = parser.try_parse();
+    return result.ok() ? to_sexpr(*result.ast) : result.error.message();
+}
+
+TEST(operators, test_parse_user_operators)
+{
+    auto ops = make_operators();
+    EXPECT_EQ(parse_str("a ** b ** c * d", *ops), "(* (** a (** b c)) d)");
+    EXPECT_EQ(parse_str("a % b * c", *ops), "(* (% a b) c)");
+    EXPECT_EQ(parse_str("a << b + 1 < c", *ops), "(< (<< a (+ b 1)) c)");
+    EXPECT_EQ(parse_str("x in s && index", *ops), "(&& (in x s) index)");
+    EXPECT_EQ(parse_str("!a! + -b", *ops), "(+ (! (a !)) (- b))");
+    /// built-in operators still win when they are longer
+    EXPECT_EQ(parse_str("a != b <= c", *ops), "(!= a (<= b c))");
+    EXPECT_EQ(parse_str("a ** in", *ops), "unexpected token 'in'");
+}
+
+TEST(operators, test_lex_user_operators)
+{
+    auto ops = make_operators();
+    auto tokens = tokenize("a**b<<=c in1 !=", *ops);
+    std::vector<std::string> lexemes;
+    for (auto& token : tokens) {
+        lexemes.emplace_back(token.lexeme());
+    }
+    EXPECT_EQ(lexemes, (std::vector<std::string>{ "a", "**", "b", "<<", "=", "c", "in1", "!=" }));
+    EXPECT_GE(tokens[1].token_type, TOK_USER);
+    EXPECT_EQ(tokens[6].token_type, TOK_ID);
+    EXPECT_EQ(tokens[7].token_type, TOK_NE);
+
+    /// without the table the same text is built-in tokens only
+    tokens = tokenize("a**b");
+    EXPECT_EQ(tokens.size(), 4u);
+    EXPECT_EQ(tokens[1].token_type, TOK_STAR);
+}
+
+TEST(operators, test_token_types_are_process_wide)
+{
+    OperatorRegistry first;
+    OperatorRegistry second;
+    TokenType a = first.add_infix("**", PREC_MULTIPLICATIVE + 5);
+    TokenType b = second.add_prefix("**", PREC_UNARY);
+    EXPECT_EQ(a, b);
+    EXPECT_EQ(intern_operator("**"), a);
+    EXPECT_STREQ(Lexeme(a), "**");
+
+    /// roles are per table
+    auto infix = first.freeze();
+    auto prefix = second.freeze();
+    EXPECT_EQ(infix->infix_kind(a), INFIX_BINARY_LEFT);
+    EXPECT_EQ(infix->prefix_kind(a), PREFIX_NONE);
+    EXPECT_EQ(prefix->prefix_kind(a), PREFIX_UNARY);
+    EXPECT_EQ(OperatorTable::builtin().infix_kind(a), INFIX_NONE);
+}
+
+TEST(operators, test_rejects_bad_definitions)
+{
+    OperatorRegistry registry;
+    EXPECT_THROW(registry.add_infix("", PREC_ADDITIVE), std::invalid_argument);
+    EXPECT_THROW(registry.add_infix("a+", PREC_ADDITIVE), std::invalid_argument);
+    EXPECT_THROW(registry.add_infix("1x", PREC_ADDITIVE), std::invalid_argument);
+    EXPECT_THROW(registry.add_infix("(", PREC_ADDITIVE), std::invalid_argument);
+    EXPECT_THROW(registry.add_infix(";;", PREC_ADDITIVE), std::invalid_argument);
+    EXPECT_THROW(registry.add_infix("+", PREC_ADDITIVE), std::invalid_argument);
+    EXPECT_THROW(registry.add_infix("&&", PREC_ADDITIVE), std::invalid_argument);
+    EXPECT_THROW(registry.add_infix("%", 0), std::invalid_argument);
+    registry.add_infix("%", PREC_MULTIPLICATIVE);
+    EXPECT_THROW(registry.add_infix("%", PREC_ADDITIVE), std::invalid_argument);
+    EXPECT_THROW(registry.add_postfix("%", PREC_POSTFIX), std::invalid_argument);
+    registry.add_prefix("%", PREC_UNARY);
+}
+
+TEST(operators, test_user_operators_everywhere)
+{
+    auto ops = make_operators();
+    std::vector<std::string> out;
+    StreamParser stream([&out](const Expr_t& expr) { out.push_back(to_sexpr(*expr)); });
+    stream.set_operators(*ops);
+    stream.feed("a ** 2; b in c\n");
+    stream.finish();
+    EXPECT_EQ(out, (std::vector<std::string>{ "(** a 2)", "(in b c)" }));
+
+    /// parsing is syntax only, evaluators don't know these operators
+    auto tokens = tokenize("2 ** 3", *ops);
+    Parser parser(tokens);
+    parser.set_operators(*ops);
+    Bindings bindings;
+    try {
+        evaluate(*parser.parse(), bindings);
+        FAIL();
+    } catch (const EvalError& e) {
+        EXPECT_EQ(std::string(e.what()), "not an arithmetic operator: **");
+    }
+}
+
+TEST(operators, test_shared_between_threads)
+{
+    auto ops = make_operators();
+    std::vector<std::string> results(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < results.size(); t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 200; i++) {
+                results[t] = parse_str("a ** b % c in d << !e", *ops);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& result : results) {
+        EXPECT_EQ(result, "(in (% (** a b) c) (<< d (! e)))");
+    }
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include "eval.h"
+#include "operators.h"
+#include "optimize.h"
+#include "precedence.h"
+#include "test_util.h"
+
+#include <string>
+
+using namespace pp_expr;
+
+
+
+static std::string optimized_str(const std::string& source)
+{
+    return expr_str(*optimize(parse_str(source)));
+}
+
+TEST(optimize, test_constant_folding)
+{
+    EXPECT_EQ(optimized_str("(3 + 4) * x"), "(* 7 x)");
+    EXPECT_EQ(optimized_str("2 * 3 + 4 / 8 - -1"), "7.5");
+    EXPECT_EQ(optimized_str("1 < 2 == 1"), "1");
+    EXPECT_EQ(optimized_str("x[1 + 2]"), "([ x 3)");
+    EXPECT_EQ(optimized_str("x = 2 * 5"), "(= x 10)");
+}
+
+TEST(optimize, test_identities)
+{
+    EXPECT_EQ(optimized_str("-(-a)"), "a");
+    EXPECT_EQ(optimized_str("+a"), "a");
+    EXPECT_EQ(optimized_str("x * 1 + 0"), "x");
+    EXPECT_EQ(optimized_str("1 * (x - 0) / 1"), "x");
+    EXPECT_EQ(optimized_str("0 + x * (3 - 2)"), "x");
+    /// not identities
+    EXPECT_EQ(optimized_str("x * 0"), "(* x 0)");
+    EXPECT_EQ(optimized_str("0 - x"), "(- 0 x)");
+}
+
+TEST(optimize, test_conditionals)
+{
+    EXPECT_EQ(optimized_str("1 ? a : b"), "a");
+    EXPECT_EQ(optimized_str("2 - 2 ? a : b + 0"), "b");
+    EXPECT_EQ(optimized_str("c ? 1 + 1 : b"), "(? c 2 b)");
+    EXPECT_EQ(optimized_str("0 && (x = 1)"), "0");
+    EXPECT_EQ(optimized_str("3 || x++"), "1");
+    EXPECT_EQ(optimized_str("1 && x"), "(!= x 0)");
+    EXPECT_EQ(optimized_str("0 || 5"), "1");
+    EXPECT_EQ(optimized_str("x && 0"), "(&& x 0)");
+}
+
+TEST(optimize, test_lvalues_keep_shape)
+{
+    EXPECT_EQ(optimized_str("+a = 1"), "(= (+ a) 1)");
+    EXPECT_EQ(optimized_str("++v[1 + 1]"), "(++ ([ v 2))");
+    EXPECT_EQ(optimized_str("v[0 * 1]--"), "(([ v 0) --)");
+}
+
+TEST(optimize, test_shares_unchanged_subtrees)
+{
+    auto ast = parse_str("a + b * c");
+    EXPECT_EQ(optimize(ast), ast);
+
+    auto mixed = parse_str("(a + b) * (1 + 1)");
+    auto optimized = optimize(mixed);
+    auto& before = static_cast<const BinaryExpr&>(*mixed);
+    auto& after = static_cast<const BinaryExpr&>(*optimized);
+    EXPECT_EQ(before.left(), after.left());
+}
+
+TEST(optimize, test_deep_tree)
+{
+    /// left associative chains parse without nesting, but are as deep as long
+    std::string variables = "a", ones = "1";
+    for (int i = 1; i < 200000; i++) {
+        variables += " + a";
+        ones += "+1";
+    }
+    auto ast = parse_str(variables);
+    EXPECT_EQ(optimize(ast), ast);
+    EXPECT_EQ(optimized_str(ones), "200000");
+}
+
+TEST(optimize, test_same_result)
+{
+    const char* sources[] = {
+        "(3 + 4) * x - -(-y) * 1",
+        "x > 2 && 1 || 0 && y",
+        "1 ? x / 1 + 0 : y",
+        "0 || x != y",
+    };
+    for (auto* source : sources) {
+        auto ast = parse_str(source);
+        Bindings bindings;
+        bindings.set("x", 3);
+        bindings.set("y", -2);
+        EXPECT_EQ(evaluate(*optimize(ast), bindings), evaluate(*ast, bindings)) << source;
+    }
+}
+
+TEST(optimize, test_keeps_user_operators)
+{
+    OperatorRegistry registry;
+    registry.add_infix("**", PREC_MULTIPLICATIVE + 5, Assoc::Right);
+    registry.add_prefix("!", PREC_UNARY);
+    registry.add_postfix("!", PREC_POSTFIX);
+    auto ops = registry.freeze();
+    auto optimized_user = [&](const std::string& source) {
+        return expr_str(*optimize(parse_str(source, *ops)));
+    };
+    /// operands are still folded, the operators themselves stay
+    EXPECT_EQ(optimized_user("2 ** 3 + a!"), "(+ (** 2 3) (a !))");
+    EXPECT_EQ(optimized_user("(1 + 1) ** !(2 * 3)"), "(** 2 (! 6))");
+}
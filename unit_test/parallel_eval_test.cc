@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include "parallel_eval.h"
+#include "test_util.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace pp_expr;
+
+TEST(thread_pool, test_parallel_for)
+{
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.size(), 4u);
+    std::vector<int> hits(10007, 0);
+    pool.parallel_for(hits.size(), [&](size_t i) { hits[i]++; });
+    for (auto hit : hits) {
+        ASSERT_EQ(hit, 1);
+    }
+    /// pool is reusable, empty loops return
+    std::atomic<size_t> sum{0};
+    pool.parallel_for(100, [&](size_t i) { sum += i; });
+    EXPECT_EQ(sum, 4950u);
+    pool.parallel_for(0, [&](size_t) { sum = 0; });
+    EXPECT_EQ(sum, 4950u);
+}
+
+TEST(thread_pool, test_parallel_for_throws)
+{
+    /// throws on workers and on the calling thread alike
+    for (size_t threads : { 1, 4 }) {
+        ThreadPool pool(threads);
+        std::vector<std::atomic<int>> hits(1000);
+        EXPECT_THROW(pool.parallel_for(hits.size(), [&](size_t i) {
+            hits[i]++;
+            if (i % 7 == 0) {
+                throw std::runtime_error("index " + std::to_string(i));
+            }
+        }), std::runtime_error);
+        for (auto& hit : hits) {
+            ASSERT_EQ(hit, 1);
+        }
+        std::atomic<size_t> sum{0};
+        pool.parallel_for(100, [&](size_t i) { sum += i; });
+        EXPECT_EQ(sum, 4950u);
+    }
+}
+
+TEST(parallel_eval, test_matches_serial)
+{
+    const size_t rows = 100003;
+    std::vector<double> a(rows), b(rows);
+    for (size_t i = 0; i < rows; i++) {
+        a[i] = static_cast<double>(i % 97) * 0.25;
+        b[i] = static_cast<double>(i % 13);
+    }
+    Columns columns;
+    columns.bind("a", a.data());
+    columns.bind("b", b.data());
+    BatchProgram program(*parse_str("a * 2 > b ? a - b : b / 3"));
+
+    std::vector<double> serial(rows), parallel(rows);
+    program.run(columns, 0, rows, serial.data());
+    ThreadPool pool(3);
+    evaluate_parallel(program, columns, rows, parallel.data(), pool, 1000);
+    EXPECT_EQ(serial, parallel);
+}
+
+TEST(parallel_eval, test_deterministic_reduction)
+{
+    const size_t rows = 50001;
+    std::vector<double> x(rows);
+    for (size_t i = 0; i < rows; i++) {
+        x[i] = 1.0 / static_cast<double>(i + 1);
+    }
+    Columns columns;
+    columns.bind("x", x.data());
+    BatchProgram program(*parse_str("x * 3"));
+    BatchProgram filter(*parse_str("x > 0.001"));
+
+    ThreadPool pool1(1);
+    ThreadPool pool4(4);
+    double sum1 = reduce_parallel(program, columns, rows, Reduction::Sum, pool1, 777);
+    double sum4 = reduce_parallel(program, columns, rows, Reduction::Sum, pool4, 777);
+    /// bitwise identical whatever the thread count
+    EXPECT_EQ(sum1, sum4);
+    EXPECT_NEAR(sum1, 3 * 11.397, 0.01);
+
+    EXPECT_EQ(reduce_parallel(filter, columns, rows, Reduction::Count, pool4, 777), 999);
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "parse_stats.h"
+#include "parser.h"
+
+#include <sstream>
+#include <vector>
+
+using namespace pp_expr;
+
+struct CollectSink : public ParseStatsSink {
+    void on_parse(const ParseStats& stats) override { parses.push_back(stats); }
+    std::vector<ParseStats> parses;
+};
+
+#if PP_EXPR_INSTRUMENT
+static size_t nodes_of(const ParseStats& stats, ExprKind kind)
+{
+    return stats.nodes[static_cast<size_t>(kind)];
+}
+#endif
+
+TEST(parse_stats, test_counters)
+{
+    auto tokens = tokenize("-a[1] + b++ * (c ? 2 : d)");
+    Parser parser(tokens);
+    CollectSink sink;
+    parser.set_stats_sink(&sink);
+    ASSERT_TRUE(parser.try_parse().ok());
+    const auto& stats = parser.stats();
+
+#if PP_EXPR_INSTRUMENT
+    EXPECT_EQ(stats.tokens, tokens.size());
+    EXPECT_EQ(nodes_of(stats, ExprKind::Number), 2u);
+    EXPECT_EQ(nodes_of(stats, ExprKind::Ident), 4u);
+    EXPECT_EQ(nodes_of(stats, ExprKind::Unary), 1u);
+    EXPECT_EQ(nodes_of(stats, ExprKind::PostfixUnary), 1u);
+    EXPECT_EQ(nodes_of(stats, ExprKind::Binary), 3u);
+    EXPECT_EQ(nodes_of(stats, ExprKind::Tenary), 1u);
+    EXPECT_EQ(stats.node_count(), 12u);
+    /// + * ( ?
+    EXPECT_EQ(stats.max_depth, 4u);
+    /// one allocation per heap node, plus the frame stack
+    EXPECT_GE(stats.allocs, 12u);
+    EXPECT_GT(stats.alloc_bytes, 12 * sizeof(Number));
+    EXPECT_FALSE(stats.failed);
+    ASSERT_EQ(sink.parses.size(), 1u);
+    EXPECT_EQ(sink.parses[0].node_count(), 12u);
+#else
+    /// compiled out: nothing counted, sink never called
+    EXPECT_EQ(stats.tokens, 0u);
+    EXPECT_EQ(stats.node_count(), 0u);
+    EXPECT_TRUE(sink.parses.empty());
+#endif
+}
+
+TEST(parse_stats, test_sink_per_expression)
+{
+    auto tokens = tokenize("a + 1; (b; c");
+    Parser parser(tokens);
+    CollectSink sink;
+    set_default_stats_sink(&sink);
+    auto results = parser.parse_all();
+    set_default_stats_sink(nullptr);
+    ASSERT_EQ(results.size(), 3u);
+
+#if PP_EXPR_INSTRUMENT
+    ASSERT_EQ(sink.parses.size(), 3u);
+    EXPECT_EQ(sink.parses[0].tokens, 3u);
+    EXPECT_FALSE(sink.parses[0].failed);
+    EXPECT_TRUE(sink.parses[1].failed);
+    EXPECT_EQ(sink.parses[2].node_count(), 1u);
+
+    ParseStats total;
+    for (auto& stats : sink.parses) {
+        total += stats;
+    }
+    EXPECT_EQ(total.node_count(), 5u);
+    EXPECT_TRUE(total.failed);
+    std::ostringstream ostr;
+    ostr << total;
+    EXPECT_NE(ostr.str().find("nodes=5 (number=1 ident=3 unary=0 postfix=0 binary=1 tenary=0)"),
+        std::string::npos) << ostr.str();
+#else
+    EXPECT_TRUE(sink.parses.empty());
+#endif
+}
@@ -1,10 +1,13 @@
 #include <gtest/gtest.h>
 
 #include "parser.h"
+#include "lexer.h"
+#include "precedence.h"
 
 #include <iostream>
 #include <cassert>
 #include <sstream>
+#include <thread>
 
 using namespace pp_expr;
 
@@ -359,3 +362,213 @@ TEST(parser, test_indexing)
         EXPECT_EQ(ast_str, "([ a (+ 1 3))");
     }
 }
+
+TEST(parser, test_precedence_table)
+{
+    static_assert(get_precedence(TOK_STAR) > get_precedence(TOK_PLUS), "");
+    static_assert(get_precedence(TOK_ASSIGN) < get_precedence(TOK_QUESTION), "");
+    static_assert(get_precedence(TOK_RPAREN) == PREC_NONE, "");
+    static_assert(unary_op_precedences[TOK_MINUS] == PREC_UNARY, "");
+    static_assert(unary_op_precedences[TOK_SLASH] == PREC_NONE, "");
+    EXPECT_EQ(get_precedence(TOK_COLON), 0);
+}
+
+TEST(parser, test_concurrent_parse)
+{
+    /// *++a++ = i==0 ? 2+3 : 4*5
+    std::vector<Token> tokens = {
+        { TOK_STAR, "*" },
+        { TOK_INC, "++" },
+        { TOK_ID, "a" },
+        { TOK_INC, "++" },
+        { TOK_ASSIGN, "=" },
+        { TOK_ID, "i" },
+        { TOK_EQ, "=="},
+        { TOK_NUM, "0"},
+        { TOK_QUESTION, "?"},
+        { TOK_NUM, "2"},
+        { TOK_PLUS, "+" },
+        { TOK_NUM, "3" },
+        { TOK_COLON, ":" },
+        { TOK_NUM, "4"},
+        { TOK_STAR, "*" },
+        { TOK_NUM, "5" },
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<int> failures(4, 0);
+    for (size_t t = 0; t < failures.size(); t++) {
+        threads.emplace_back([&tokens, &failures, t] {
+            for (int i = 0; i < 1000; i++) {
+                Parser parser(tokens);
+                std::ostringstream ostr;
+                ostr << *parser.parse();
+                if (ostr.str() != "(= (* (++ (a ++))) (? (== i 0) (+ 2 3) (* 4 5)))") {
+                    failures[t]++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto failure : failures) {
+        EXPECT_EQ(failure, 0);
+    }
+}
+
+TEST(parser, test_deep_nesting)
+{
+    const int depth = 200000;
+    {
+        std::string source = std::string(depth, '(') + "a" + std::string(depth, ')');
+        auto tokens = tokenize(source);
+        Parser parser(tokens);
+        parser.set_max_depth(depth);
+        auto ast = parser.parse();
+        ASSERT_FALSE(parser.failed()) << parser.diagnostic().message();
+        EXPECT_EQ(ast->kind(), ExprKind::Ident);
+    }
+    {
+        std::string source;
+        for (int i = 0; i < depth; i++) {
+            source += "- ";
+        }
+        source += "a";
+        auto tokens = tokenize(source);
+        Parser parser(tokens);
+        parser.set_max_depth(depth);
+        auto ast = parser.parse();
+        ASSERT_FALSE(parser.failed()) << parser.diagnostic().message();
+        int levels = 0;
+        for (const Expr* node = ast.get(); node->kind() == ExprKind::Unary; levels++) {
+            node = static_cast<const UnaryExpr*>(node)->operand().get();
+        }
+        EXPECT_EQ(levels, depth);
+    }
+    {
+        std::string source;
+        for (int i = 0; i < depth; i++) {
+            source += "a = ";
+        }
+        source += "1";
+        auto tokens = tokenize(source);
+        Parser parser(tokens);
+        parser.set_max_depth(depth);
+        auto ast = parser.parse();
+        ASSERT_FALSE(parser.failed()) << parser.diagnostic().message();
+        int levels = 0;
+        for (const Expr* node = ast.get(); node->kind() == ExprKind::Binary; levels++) {
+            node = static_cast<const BinaryExpr*>(node)->right().get();
+        }
+        EXPECT_EQ(levels, depth);
+    }
+}
+
+/// destroyed at exit, after the main thread's thread_locals
+static Expr_t g_rule;
+
+TEST(parser, test_static_tree)
+{
+    auto tokens = tokenize("a + b * c - d");
+    Parser parser(tokens);
+    g_rule = parser.parse();
+    std::ostringstream ostr;
+    ostr << *g_rule;
+    EXPECT_EQ(ostr.str(), "(- (+ a (* b c)) d)");
+}
+
+TEST(parser, test_max_depth)
+{
+    /// open at the innermost 'c': ( ( + - ( [ (
+    auto tokens = tokenize("((a + -(b[(c)])))");
+    {
+        Parser parser(tokens);
+        parser.set_max_depth(6);
+        EXPECT_FALSE(parser.parse());
+        EXPECT_TRUE(parser.failed());
+        EXPECT_EQ(parser.diagnostic().code, ParseError::TooDeep);
+        EXPECT_EQ(parser.diagnostic().got.lexeme(), "(");
+    }
+    {
+        Parser parser(tokens);
+        parser.set_max_depth(7);
+        auto ast = parser.parse();
+        ASSERT_FALSE(parser.failed()) << parser.diagnostic().message();
+        std::ostringstream ostr;
+        ostr << *ast;
+        EXPECT_EQ(ostr.str(), "(+ a (- ([ b c)))");
+    }
+}
+
+TEST(parser, test_malformed)
+{
+    auto error_of = [](const char* source) {
+        auto tokens = tokenize(source);
+        Parser parser(tokens);
+        EXPECT_FALSE(parser.parse());
+        return parser.diagnostic().message();
+    };
+    EXPECT_EQ(error_of("(a + b"), "expected ')', got end of input");
+    EXPECT_EQ(error_of("a[1 2"), "expected ']', got '2'");
+    EXPECT_EQ(error_of("a ? b c"), "expected ':', got 'c'");
+    EXPECT_EQ(error_of("a +"), "unexpected end of input");
+    EXPECT_EQ(error_of("a + )"), "unexpected token ')'");
+    EXPECT_EQ(error_of("a b"), "unexpected token 'b'");
+    EXPECT_EQ(error_of("a $ b"), "invalid character '$'");
+    EXPECT_EQ(error_of("a; b"), "unexpected token ';'");
+}
+
+TEST(parser, test_diagnostic_position)
+{
+    std::string source = "x = (a + b * c";
+    auto tokens = tokenize(source);
+    Parser parser(tokens);
+    auto result = parser.try_parse();
+    ASSERT_FALSE(result.ok());
+    EXPECT_EQ(result.error.code, ParseError::MissingToken);
+    EXPECT_EQ(result.error.expected, TOK_RPAREN);
+    EXPECT_EQ(result.error.got.token_type, TOK_COUNT);
+    EXPECT_EQ(result.error.token_index, tokens.size());
+    EXPECT_EQ(result.error.offset(source), source.size());
+
+    source = "x = a +* ]";
+    tokens = tokenize(source);
+    Parser parser2(tokens);
+    result = parser2.try_parse();
+    EXPECT_EQ(result.error.code, ParseError::UnexpectedToken);
+    EXPECT_EQ(result.error.token_index, 5u);
+    EXPECT_EQ(result.error.offset(source), 9u);
+    EXPECT_STREQ(ParseErrorName(result.error.code), "unexpected-token");
+}
+
+TEST(parser, test_parse_all_resync)
+{
+    std::string source = "a + 1; (b; c ? d : e;; f[1 g; -; h = 2; $";
+    auto tokens = tokenize(source);
+    Parser parser(tokens);
+    auto results = parser.parse_all();
+    ASSERT_EQ(results.size(), 7u);
+
+    std::vector<std::string> parsed;
+    for (auto& result : results) {
+        if (result.ok()) {
+            std::ostringstream ostr;
+            ostr << *result.ast;
+            parsed.push_back(ostr.str());
+        } else {
+            parsed.push_back(std::string(ParseErrorName(result.error.code)) + "@"
+                + std::to_string(result.error.offset(source)));
+        }
+    }
+    std::vector<std::string> expected = {
+        "(+ a 1)",
+        "missing-token@9",
+        "(? c d e)",
+        "missing-token@27",
+        "unexpected-token@31",
+        "(= h 2)",
+        "invalid-token@40",
+    };
+    EXPECT_EQ(parsed, expected);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include "builder.h"
+#include "serialize.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <limits>
+#include <string>
+
+using namespace pp_expr;
+
+TEST(serialize, test_sexpr_matches_ostream)
+{
+    const char* sources[] = {
+        "-+a = b == 10 ? c > 30 : d != 80",
+        "*++a++ = i==0 ? 2+3 : 4*5",
+        "a ? b ? c : d : e",
+        "-a[10][1] + b--",
+        "0.1 + 1234567 * 123456 - 1e-5 / .5 + 1e300 * 100000 + 3.14159265 + 2.5e-7",
+    };
+    for (auto* source : sources) {
+        auto ast = parse_str(source);
+        EXPECT_EQ(to_sexpr(*ast), expr_str(*ast)) << source;
+    }
+
+    /// numbers the parser can't produce directly
+    auto& builder = heap_builder();
+    const double numbers[] = {
+        -0.0, -2.5, 1e16, 123456.5, 999999.5, 1e-300, 4.9e-324,
+        std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::infinity(),
+        -std::numeric_limits<double>::infinity(),
+        std::numeric_limits<double>::quiet_NaN(),
+    };
+    for (double value : numbers) {
+        auto number = builder.number(value);
+        EXPECT_EQ(to_sexpr(*number), expr_str(*number)) << value;
+    }
+}
+
+TEST(serialize, test_fixed_buffer)
+{
+    auto ast = parse_str("a + b * 10");
+    char data[8];
+    TextBuffer out(data, sizeof(data));
+    write_sexpr(*ast, out);
+    /// "(+ a (* b 10))" is 14 bytes
+    EXPECT_TRUE(out.overflowed());
+    EXPECT_EQ(out.size(), 14u);
+    EXPECT_EQ(out.view(), "(+ a (* ");
+
+    char big[32];
+    TextBuffer fits(big, sizeof(big));
+    write_sexpr(*ast, fits);
+    EXPECT_FALSE(fits.overflowed());
+    EXPECT_EQ(fits.view(), "(+ a (* b 10))");
+
+    /// growable buffer reused after clear()
+    TextBuffer grow;
+    for (int i = 0; i < 100; i++) {
+        write_sexpr(*ast, grow);
+    }
+    EXPECT_EQ(grow.size(), 1400u);
+    grow.clear();
+    write_sexpr(*ast, grow);
+    EXPECT_EQ(grow.view(), "(+ a (* b 10))");
+}
+
+TEST(serialize, test_json)
+{
+    EXPECT_EQ(to_json(*parse_str("-a[1] + b++")),
+        "{\"type\":\"binary\",\"op\":\"+\","
+        "\"left\":{\"type\":\"unary\",\"op\":\"-\",\"operand\":"
+            "{\"type\":\"binary\",\"op\":\"[\","
+            "\"left\":{\"type\":\"ident\",\"name\":\"a\"},"
+            "\"right\":{\"type\":\"number\",\"value\":1}}},"
+        "\"right\":{\"type\":\"postfix\",\"op\":\"++\",\"operand\":{\"type\":\"ident\",\"name\":\"b\"}}}");
+    EXPECT_EQ(to_json(*parse_str("c ? 0.1 : 1e300")),
+        "{\"type\":\"tenary\",\"op\":\"?\","
+        "\"cond\":{\"type\":\"ident\",\"name\":\"c\"},"
+        "\"then\":{\"type\":\"number\",\"value\":0.1},"
+        "\"else\":{\"type\":\"number\",\"value\":1e+300}}");
+
+    auto& builder = heap_builder();
+    EXPECT_EQ(to_json(*builder.number(std::numeric_limits<double>::infinity())),
+        "{\"type\":\"number\",\"value\":\"inf\"}");
+    EXPECT_EQ(to_json(*builder.ident("we\"ird\\\n")),
+        "{\"type\":\"ident\",\"name\":\"we\\\"ird\\\\\\u000a\"}");
+}
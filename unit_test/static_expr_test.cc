@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include "eval.h"
+#include "lexer.h"
+#include "parser.h"
+#include "serialize.h"
+#include "static_expr.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+using namespace pp_expr;
+
+/// fully evaluated by the compiler
+static_assert(PP_EXPR_STATIC("1 + 2 * 3 - 4 / 8")() == 6.5, "");
+static_assert(PP_EXPR_STATIC("(1 + 2) * 3 < 10 ? 1 : 2")() == 1, "");
+static_assert(PP_EXPR_STATIC("x * x + y")(3, 1) == 10, "");
+static_assert(PP_EXPR_STATIC("a = b = 2")(0, 0) == 2, "");
+static_assert(PP_EXPR_STATIC("a * b + a").arity == 2, "");
+static_assert(PP_EXPR_STATIC("a * b + a").index_of("b") == 1, "");
+static_assert(PP_EXPR_STATIC("a * b + a").index_of("c") == 2, "");
+
+TEST(static_expr, test_same_tree_as_parser)
+{
+    auto check = [](auto expr) {
+        EXPECT_EQ(to_sexpr(*expr.to_ast()), to_sexpr(*parse_str(expr.source()))) << expr.source();
+    };
+    check(PP_EXPR_STATIC("-+a = b == 10 ? c > 30 : d != 80"));
+    check(PP_EXPR_STATIC("*++a++ = i==0 ? 2+3 : 4*5"));
+    check(PP_EXPR_STATIC("a ? b ? c : d : e = f"));
+    check(PP_EXPR_STATIC("-a[10][1] + b-- * (c - d) / e"));
+    check(PP_EXPR_STATIC("a || b && c == d < e + f * g"));
+    check(PP_EXPR_STATIC("x1 <= .5 && y >= 12.5e3 || z != 1e-5"));
+    check(PP_EXPR_STATIC("0.1 + 1234567 * 123456 - 3.14159265 + 2.5e-7"));
+}
+
+TEST(static_expr, test_matches_evaluate)
+{
+    constexpr auto f = PP_EXPR_STATIC("a * b - c / (a + 1) + (a < b && b <= c ? c : -a) + (c > 9 || 0)");
+    static_assert(f.arity == 3, "");
+    for (double a : { -2.0, 0.0, 1.5, 7.0 }) {
+        for (double b : { -1.0, 3.0 }) {
+            for (double c : { 0.0, 4.0, 10.0 }) {
+                Bindings bindings;
+                bindings.set("a", a);
+                bindings.set("b", b);
+                bindings.set("c", c);
+                EXPECT_EQ(f(a, b, c), evaluate(*parse_str(f.source()), bindings));
+            }
+        }
+    }
+}
+
+TEST(static_expr, test_assignment_writes_through)
+{
+    auto f = PP_EXPR_STATIC("total = total + x++ * 2");
+    ASSERT_EQ(f.index_of("total"), 0u);
+    double vars[] = { 1, 5 };
+    EXPECT_EQ(f.eval(vars), 11);
+    EXPECT_EQ(f.eval(vars), 23);
+    EXPECT_EQ(vars[0], 23);
+    EXPECT_EQ(vars[1], 7);
+    /// by value arguments are left alone
+    double total = 1;
+    EXPECT_EQ(f(total, 5), 11);
+    EXPECT_EQ(total, 1);
+}
+
+TEST(static_expr, test_number_literals)
+{
+    static_assert(ct::parse_number("12.5e3") == 12500.0, "");
+    static_assert(ct::parse_number(".5") == 0.5, "");
+    static_assert(ct::parse_number("0.1") == 0.1, "");
+    static_assert(ct::parse_number("1e-5") == 1e-5, "");
+    static_assert(ct::parse_number("2.5e-7") == 2.5e-7, "");
+    EXPECT_DOUBLE_EQ(ct::parse_number("1e300"), 1e300);
+    EXPECT_DOUBLE_EQ(ct::parse_number("123456789012345678901234"), 123456789012345678901234.0);
+}
+
+TEST(static_expr, test_malformed_input)
+{
+    /// at compile time these are errors, at run time the parser throws
+    for (const char* source : { "a +", "(a", "a b", "a ? b", "a )", "!a", "a[1" }) {
+        std::string_view text(source);
+        EXPECT_THROW(ct::StaticParser<16>(text).parse(), std::invalid_argument) << source;
+    }
+}
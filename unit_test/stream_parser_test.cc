@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "stream_parser.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace pp_expr;
+
+static std::vector<std::string> stream_all(const std::string& input, size_t chunk_size,
+    size_t max_expr_bytes = 1024)
+{
+    std::vector<std::string> out;
+    StreamParser parser([&out](const Expr_t& expr) {
+        std::ostringstream ostr;
+        ostr << *expr;
+        out.push_back(ostr.str());
+    }, max_expr_bytes);
+    for (size_t i = 0; i < input.size(); i += chunk_size) {
+        parser.feed(std::string_view(input).substr(i, chunk_size));
+        EXPECT_LE(parser.pending_bytes(), max_expr_bytes);
+    }
+    parser.finish();
+    return out;
+}
+
+TEST(stream_parser, test_any_chunking)
+{
+    std::string input = "a + b * c;\n-x[10]-- ; \n\n*++a++ = i==0 ? 2+3 : 4*5\nlast<=1";
+    std::vector<std::string> expected = {
+        "(+ a (* b c))",
+        "(- (([ x 10) --))",
+        "(= (* (++ (a ++))) (? (== i 0) (+ 2 3) (* 4 5)))",
+        "(<= last 1)",
+    };
+    for (size_t chunk = 1; chunk <= input.size(); chunk++) {
+        EXPECT_EQ(stream_all(input, chunk), expected) << "chunk size " << chunk;
+    }
+}
+
+TEST(stream_parser, test_emits_on_separator)
+{
+    std::vector<std::string> out;
+    StreamParser parser([&out](const Expr_t& expr) {
+        std::ostringstream ostr;
+        ostr << *expr;
+        out.push_back(ostr.str());
+    });
+    parser.feed("a +");
+    EXPECT_TRUE(out.empty());
+    EXPECT_EQ(parser.pending_bytes(), 3u);
+    parser.feed(" b;c");
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0], "(+ a b)");
+    EXPECT_EQ(parser.pending_bytes(), 1u);
+    parser.finish();
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[1], "c");
+}
+
+TEST(stream_parser, test_oversized_expression_skipped)
+{
+    std::string input = "a;" + std::string(40, 'x') + " + 1;b\n" + std::string(20, 'y') + ";c";
+    for (size_t chunk : { 1, 3, 7, 100 }) {
+        std::vector<std::string> out;
+        StreamParser parser([&out](const Expr_t& expr) {
+            std::ostringstream ostr;
+            ostr << *expr;
+            out.push_back(ostr.str());
+        }, 16);
+        for (size_t i = 0; i < input.size(); i += chunk) {
+            parser.feed(std::string_view(input).substr(i, chunk));
+            EXPECT_LE(parser.pending_bytes(), 16u);
+        }
+        parser.finish();
+        EXPECT_EQ(out, (std::vector<std::string>{ "a", "b", "c" })) << "chunk size " << chunk;
+        EXPECT_EQ(parser.oversized(), 2u);
+    }
+}
+
+TEST(stream_parser, test_reports_errors)
+{
+    std::vector<std::string> out;
+    std::vector<std::string> errors;
+    StreamParser parser([&out](const Expr_t& expr) {
+        std::ostringstream ostr;
+        ostr << *expr;
+        out.push_back(ostr.str());
+    });
+    parser.on_error([&errors](const Diagnostic& error, std::string_view source) {
+        errors.push_back(std::string(source) + ": " + error.message()
+            + " at " + std::to_string(error.offset(source)));
+    });
+    std::string input = "a+;b)\nc[1;d";
+    for (char c : input) {
+        parser.feed(std::string_view(&c, 1));
+    }
+    parser.finish();
+    EXPECT_EQ(out, (std::vector<std::string>{ "d" }));
+    EXPECT_EQ(errors, (std::vector<std::string>{
+        "a+: unexpected end of input at 2",
+        "b): unexpected token ')' at 1",
+        "c[1: expected ']', got end of input at 3",
+    }));
+    EXPECT_EQ(parser.failures(), 3u);
+}
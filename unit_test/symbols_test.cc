@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include "flat_ast.h"
+#include "hash_cons.h"
+#include "symbols.h"
+#include "test_util.h"
+#include "visitor.h"
+
+#include <string>
+#include <vector>
+
+using namespace pp_expr;
+
+TEST(symbols, test_intern)
+{
+    SymbolTable symbols;
+    EXPECT_EQ(symbols.intern("a"), 0u);
+    EXPECT_EQ(symbols.intern("bb"), 1u);
+    EXPECT_EQ(symbols.intern(std::string("a")), 0u);
+    EXPECT_EQ(symbols.find("bb"), 1u);
+    EXPECT_EQ(symbols.find("c"), kNoSymbol);
+    EXPECT_EQ(symbols.size(), 2u);
+    EXPECT_EQ(symbols.name(1), "bb");
+
+    /// names stay valid as the table grows
+    for (int i = 0; i < 1000; i++) {
+        symbols.intern("x" + std::to_string(i));
+    }
+    EXPECT_EQ(symbols.find("bb"), 1u);
+    EXPECT_EQ(symbols.find("x999"), 1001u);
+    EXPECT_EQ(symbols.name(0), "a");
+}
+
+static void collect_ids(const Expr& expr, std::vector<std::pair<std::string, uint32_t>>& out)
+{
+    visit_expr(expr, [&](auto& node) {
+        using T = std::decay_t<decltype(node)>;
+        if constexpr (std::is_same_v<T, Ident>) {
+            out.emplace_back(node.value(), node.id());
+        } else if constexpr (std::is_same_v<T, BinaryExpr>) {
+            collect_ids(*node.left(), out);
+            collect_ids(*node.right(), out);
+        } else if constexpr (std::is_base_of_v<UnaryExpr, T>) {
+            collect_ids(*node.operand(), out);
+        } else if constexpr (std::is_same_v<T, TenaryExpr>) {
+            collect_ids(*node.operand1(), out);
+            collect_ids(*node.operand2(), out);
+            collect_ids(*node.operand3(), out);
+        }
+    });
+}
+
+TEST(symbols, test_builder_stamps_ids)
+{
+    SymbolTable symbols;
+    SymbolBuilder builder(symbols);
+    std::vector<std::pair<std::string, uint32_t>> ids;
+    for (const char* source : { "b = a + b * c", "c ? a[1] : d++" }) {
+        collect_ids(*parse_str(source, builder), ids);
+    }
+    EXPECT_EQ(ids, (std::vector<std::pair<std::string, uint32_t>>{
+        { "b", 0 }, { "a", 1 }, { "b", 0 }, { "c", 2 },
+        { "c", 2 }, { "a", 1 }, { "d", 3 },
+    }));
+    EXPECT_EQ(symbols.size(), 4u);
+
+    /// without the builder identifiers have no id
+    EXPECT_EQ(expr_cast<Ident>(*parse_str("a")).id(), kNoSymbol);
+}
+
+TEST(symbols, test_builder_wraps_others)
+{
+    SymbolTable symbols;
+    HashConsBuilder hash_cons;
+    SymbolBuilder builder(symbols, hash_cons);
+    auto ast = parse_str("x + y * x", builder);
+    auto& sum = expr_cast<BinaryExpr>(*ast);
+    EXPECT_EQ(sum.left().get(), expr_cast<BinaryExpr>(*sum.right()).right().get());
+    EXPECT_EQ(expr_cast<Ident>(*sum.left()).id(), 0u);
+
+    /// builders without nodes still get their names interned
+    FlatAst flat;
+    FlatBuilder flat_builder(flat);
+    SymbolBuilder flat_symbols(symbols, flat_builder);
+    parse_str("z - x", flat_symbols);
+    EXPECT_EQ(symbols.find("z"), 2u);
+    EXPECT_EQ(flat.size(), 3u);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "builder.h"
+#include "lexer.h"
+#include "operators.h"
+#include "parser.h"
+
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace pp_expr
+{
+/// parse `source` through `builder`, a failed parse gives nullptr
+inline Expr_t parse_str(std::string_view source, AstBuilder& builder = heap_builder())
+{
+    auto tokens = tokenize(source);
+    Parser parser(tokens, builder);
+    return parser.parse();
+}
+
+/// same with user defined operators
+inline Expr_t parse_str(std::string_view source, const OperatorTable& ops)
+{
+    auto tokens = tokenize(source, ops);
+    Parser parser(tokens);
+    parser.set_operators(ops);
+    return parser.parse();
+}
+
+/// `expr` as operator << prints it
+inline std::string expr_str(const Expr& expr)
+{
+    std::ostringstream ostr;
+    ostr << expr;
+    return ostr.str();
+}
+}  // namespace pp_expr
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include "test_util.h"
+#include "visitor.h"
+
+#include <algorithm>
+#include <string>
+#include <type_traits>
+
+using namespace pp_expr;
+
+/// height of the tree and the identifiers it reads, in order
+struct Shape : public ExprVisitor<Shape, size_t> {
+    size_t visit_number(const Number&) { return 1; }
+    size_t visit_ident(const Ident& expr) {
+        names += expr.value();
+        return 1;
+    }
+    size_t visit_unary(const UnaryExpr& expr) { return 1 + visit(*expr.operand()); }
+    size_t visit_binary(const BinaryExpr& expr) {
+        size_t left = visit(*expr.left());
+        return 1 + std::max(left, visit(*expr.right()));
+    }
+    size_t visit_tenary(const TenaryExpr& expr) {
+        size_t cond = visit(*expr.operand1());
+        size_t yes = visit(*expr.operand2());
+        return 1 + std::max({ cond, yes, visit(*expr.operand3()) });
+    }
+
+    std::string names;
+};
+
+/// overrides the postfix hook that defaults to visit_unary
+struct CountPostfix : public ExprVisitor<CountPostfix> {
+    void visit_number(const Number&) {}
+    void visit_ident(const Ident&) {}
+    void visit_unary(const UnaryExpr& expr) { visit(*expr.operand()); }
+    void visit_postfix_unary(const PostfixUnaryExpr& expr) {
+        postfix++;
+        visit(*expr.operand());
+    }
+    void visit_binary(const BinaryExpr& expr) {
+        visit(*expr.left());
+        visit(*expr.right());
+    }
+    void visit_tenary(const TenaryExpr& expr) {
+        visit(*expr.operand1());
+        visit(*expr.operand2());
+        visit(*expr.operand3());
+    }
+
+    int postfix{0};
+};
+
+TEST(visitor, test_crtp_visitor)
+{
+    auto ast = parse_str("a + -b[1] * (c ? d++ : 2)");
+    Shape shape;
+    EXPECT_EQ(shape.visit(*ast), 5u);
+    EXPECT_EQ(shape.names, "abcd");
+
+    CountPostfix count;
+    count.visit(*parse_str("a++ + -b-- + ++c"));
+    EXPECT_EQ(count.postfix, 2);
+}
+
+TEST(visitor, test_visit_expr)
+{
+    auto ast = parse_str("x[2]++");
+    auto name = [](const auto& node) -> std::string {
+        using T = std::decay_t<decltype(node)>;
+        if constexpr (std::is_same_v<T, PostfixUnaryExpr>) {
+            return "postfix " + std::string(node.op().lexeme());
+        } else if constexpr (std::is_same_v<T, BinaryExpr>) {
+            return "binary";
+        } else {
+            return "other";
+        }
+    };
+    EXPECT_EQ(visit_expr(*ast, name), "postfix ++");
+    EXPECT_EQ(visit_expr(*expr_cast<PostfixUnaryExpr>(*ast).operand(), name), "binary");
+}
+
+TEST(visitor, test_casts)
+{
+    auto ast = parse_str("a++");
+    EXPECT_TRUE(isa<PostfixUnaryExpr>(*ast));
+    /// a postfix node is also a unary node
+    EXPECT_TRUE(isa<UnaryExpr>(*ast));
+    EXPECT_FALSE(isa<BinaryExpr>(*ast));
+    EXPECT_EQ(dyn_expr_cast<UnaryExpr>(ast.get()), ast.get());
+    EXPECT_EQ(dyn_expr_cast<Ident>(ast.get()), nullptr);
+    EXPECT_EQ(dyn_expr_cast<Ident>(nullptr), nullptr);
+
+    auto& unary = expr_cast<UnaryExpr>(*ast);
+    EXPECT_EQ(expr_cast<Ident>(*unary.operand()).value(), "a");
+    EXPECT_FALSE(isa<UnaryExpr>(*parse_str("-a + 1")));
+    EXPECT_TRUE(isa<UnaryExpr>(*parse_str("-a")));
+}